@@ -1,6 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define SPACER "--------------------------------------------\n"
 #define WELCOME "Welcome to UFO Sighting Viewer.\nThis program lets you view, sort, filter, and modify a large dataset of UFO sightings.\nData include location, shape, duration, and more.\nOpen the file to contiune.\n"
@@ -10,6 +25,40 @@
 #define MAX_COMMENT 236 // 235 characters is the longest comment
 #define MAX_MENU_OPTION 50
 #define MAX_SEARCH_RESULTS 10
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define MAX_LINE 512 // Longer than any line in the csv
+#define FOLLOW_POLL_SECONDS 1 // How often to check the file for new rows in follow mode
+#define TOP_K_MIN_ROWS_PER_THREAD 10000 // Smaller views are not worth starting threads for
+#define DEDUP_MAX_DISTANCE 3 // Most bits two comment SimHashes can differ by and still count as the same comment
+#define TRIGRAM_CHARS 37 // Space, letters, and digits are all that is left of a city name after normalizing
+#define TRIGRAMS (TRIGRAM_CHARS * TRIGRAM_CHARS * TRIGRAM_CHARS)
+#define MAX_FUZZY_SUGGESTIONS 10
+#define FUZZY_SHORT_LETTERS 4 // Names up to this long allow one typo, longer names two
+#define EXTERNAL_SORT_DEFAULT_MB 64 // Default memory limit for sorting a file that does not fit in memory
+#define MAX_MERGE_WAYS 256 // Most temporary files to keep open at once, to stay under the open file limit
+#define JOURNAL_EXTENSION ".journal" // Added to the data file name to get the journal file name
+#define COLUMN_MAGIC "UFOC2" // Start of a compressed column file
+#define COMMENT_BLOCK_ROWS 256 // Comments compressed together; bigger blocks compress better but take longer to reach
+#define LZ_MIN_MATCH 4 // Shortest repeat worth replacing with a reference back
+#define LZ_HASH_BITS 12
+#define TIME_SLOTS 1500 // More than the minutes in a day, so 24:00 still fits
+#define FILTER_CACHE_SIZE 8 // Most filter results to remember
+#define MAX_SEARCH_STRING 50
+#define SERVER_SOCKET "ufo.sock" // Default Unix socket for the query server
+#define BENCH_CONNECTIONS 8 // Default load generator settings
+#define BENCH_QUERIES 1000
+#define KM_PER_DEGREE 111.195 // Kilometers in a degree of latitude
+#define CLUSTER_DISTANCE_KM 50 // Default reach of a sighting when finding clusters
+#define CLUSTER_DAYS 3
+#define CLUSTER_MIN_SIGHTINGS 5
+#define CLUSTER_MIN_ROWS_PER_THREAD 20000 // Each thread gets at least this many rows when finding clusters
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_WRITE_BUFFER (1 << 20) // Export writes go through a buffer this big
+#define FLAT_MAX_FIELDS 8 // Most fields in any Arrow metadata table
+#define CSV_CHUNK (1 << 20) // Bytes of csv read and scanned at a time when loading
+#define CSV_FIELDS 10 // Fields in every row
+#define CSV_MAX_ERRORS 10 // Rows that could not be read to report by line, before only counting the rest
 
 /**
  * struct to store day, month, and year
@@ -43,9 +92,43 @@ typedef struct sightingNode {
     date dateReported;
     double latitude;
     double longitude;
+    int id; // Given by the filter cache the first time it sees the row; 0 until then
     struct sightingNode *next;
 } sightingNode;
 
+/**
+ * struct to store where a reader is in a csv file read a row at a time, so rows that can't be read are reported by line
+ */
+typedef struct csvPosition {
+    char *name; // File name for reports
+    long line; // Line the next row starts on
+    int errors; // Rows that could not be read
+} csvPosition;
+
+/**
+ * struct to store an array of pointers to the nodes shown in the viewer, in list order, so any row can be reached
+ * directly
+ */
+typedef struct viewIndex {
+    sightingNode **rows;
+    int size;
+    int capacity;
+} viewIndex;
+
+/**
+ * struct to store a trigram index of the distinct city names, for typo tolerant lookups
+ */
+typedef struct cityIndex {
+    char (*names)[MAX_CITY]; // Distinct city names as they appear in the data
+    char (*normalized)[MAX_CITY]; // The same names lowercased, without punctuation or notes in parentheses
+    int size;
+    int *table; // Hash table of city ids by name, using linear probing
+    int tableSize;
+    int **postings; // For each trigram, the ids of the cities that contain it, in increasing order
+    int *postingSizes;
+    int *postingCapacities;
+} cityIndex;
+
 // Aliases for function pointers for use in function prototypes
 typedef int (*stringPredicate)(sightingNode *, char s[]);
 
@@ -53,11 +136,239 @@ typedef int (*datePredicate)(sightingNode *, date);
 
 typedef int (*compare)(sightingNode *, sightingNode *, int);
 
+/**
+ * struct to store a bounded heap of the rows of a view that sort first, plus the part of the view a thread fills it
+ * from. The root of the heap is the kept row that sorts last, so it is the one replaced by a better row.
+ */
+typedef struct topKHeap {
+    sightingNode **rows; // Rows of the whole view; the heap stores indexes into it
+    int start; // Range of the view to offer to the heap
+    int end;
+    int k;
+    int dir;
+    compare function;
+    int *heap;
+    int size;
+} topKHeap;
+
+/**
+ * struct to store the results of one filter as a bitmap with a bit for each row id
+ */
+typedef struct filterCacheEntry {
+    stringPredicate stringSearch; // NULL for a date filter
+    char string[MAX_SEARCH_STRING];
+    datePredicate dateSearch; // NULL for a string filter
+    date d;
+    unsigned char *bits;
+    int bytes;
+    long lastUsed; // For evicting the least recently used entry
+} filterCacheEntry;
+
+/**
+ * struct to store the results of recent filters. Rows get ids in list order, so showing a cached filter only visits the
+ * set bits of its bitmap. Once rows are added, removed or reordered the ids are given again, carrying each row's bits
+ * over and checking new rows against every entry.
+ */
+typedef struct filterCache {
+    filterCacheEntry entries[FILTER_CACHE_SIZE];
+    sightingNode **nodes; // Row with each id
+    int size;
+    int nextId; // Highest id given
+    int stale; // Whether the list has changed since the ids were given
+    long clock;
+} filterCache;
+
+/**
+ * struct to store the data shared by every connection to the query server. Queries hold the lock for reading, so any
+ * number run at once. Adds and removes take turns with writeLock, sync the journal, and only then hold the lock for
+ * writing, just long enough to change the list.
+ */
+typedef struct queryServer {
+    sightingNode *head;
+    viewIndex view; // Every row in list order, for queries that need an array
+    int size;
+    FILE *journal;
+    pthread_rwlock_t lock;
+    pthread_mutex_t writeLock;
+    pthread_mutex_t connectionsLock; // Guards the open sockets
+    pthread_cond_t connectionsDone; // Signalled when a connection closes
+    int *sockets;
+    int numSockets;
+    int socketsCapacity;
+} queryServer;
+
+/**
+ * struct to store one connection to the query server
+ */
+typedef struct serverConnection {
+    queryServer *server;
+    int socket;
+} serverConnection;
+
+/**
+ * struct to store one thread of the load generator and the latency of each of its queries
+ */
+typedef struct benchWorker {
+    char *socketName;
+    int queries;
+    unsigned int seed;
+    double *latencies; // Seconds
+    int failed; // Queries that got an error or no answer
+} benchWorker;
+
+/**
+ * struct to store what a cluster of sightings has in common
+ */
+typedef struct clusterSummary {
+    int count;
+    double latitude; // Centroid
+    double longitude;
+    dateTime first;
+    dateTime last;
+    char shape[MAX_SHAPE]; // Most common shape
+} clusterSummary;
+
+/**
+ * struct to store the rows being clustered, bucketed into cells of a grid over latitude, longitude, and time. Cells
+ * are half as wide as the reach, so every row in a cell is within reach of every other, and every row within reach is
+ * at most two cells away.
+ */
+typedef struct clusterGrid {
+    sightingNode **rows;
+    int size;
+    double distance; // Kilometers
+    long window; // Minutes
+    int minPoints;
+    double cellDegrees; // Latitude and longitude size of a cell
+    long cellMinutes;
+    long *minutes; // Time of each row
+    int *latCells; // Cell of each row
+    int *lonCells;
+    int *timeCells;
+    int *cellOf; // Slot of each row's cell in the hash table
+    long long *keys; // Hash table of cells, using linear probing; -1 for an empty slot
+    int *starts; // Where each cell's rows start in points
+    int *counts;
+    int tableSize;
+    int *points; // Rows grouped by cell
+    int *cellCore; // First core row of each cell, or -1
+    char *core; // Whether each row has at least minPoints rows within reach, counting itself
+    int *border; // Core row a border row joins the cluster of, or -1
+    atomic_int *parent; // Union find forest of core rows, linked by threads at once
+} clusterGrid;
+
+/**
+ * struct to store one thread's share of a pass over the rows of a cluster grid
+ */
+typedef struct clusterWork {
+    clusterGrid *grid;
+    int start;
+    int end;
+    int pass; // 0 to find core rows, 1 to join them into clusters
+} clusterWork;
+
+
+/**
+ * struct to store a flatbuffer being built. Flatbuffers are built back to front, so a table or vector is finished
+ * before anything that refers to it, and every object is found by how far it is from the end.
+ */
+typedef struct flatBuilder {
+    unsigned char *bytes; // Used from the end towards the start
+    long capacity;
+    long size; // Bytes used at the end
+    int minAlign; // Largest alignment needed by anything in the buffer
+    long tableStart; // Size when the current table was started
+    long fields[FLAT_MAX_FIELDS]; // Size just after each field of the current table was written, or 0 if not set
+    int numFields;
+} flatBuilder;
+
+/**
+ * struct to store a growable array of bytes
+ */
+typedef struct byteBuffer {
+    unsigned char *bytes;
+    long size;
+    long capacity;
+} byteBuffer;
+
+/**
+ * struct to store a text column as a dictionary of its distinct values plus the id of each row's value, packed into
+ * only as many bits as the dictionary needs
+ */
+typedef struct dictionaryColumn {
+    char **values;
+    int size;
+    int capacity;
+    int *table; // Hash table of ids by value while building, using linear probing
+    int tableSize;
+    int bits; // Bits per id
+    byteBuffer ids;
+} dictionaryColumn;
+
+/**
+ * struct to store rows compressed by column. Dates are varints of the difference from the row before, durations and
+ * coordinates are varints, text fields are dictionary columns, and comments are compressed in blocks of rows.
+ */
+typedef struct columnStore {
+    int size;
+    byteBuffer occurred; // Date and time
+    byteBuffer reported;
+    byteBuffer durations;
+    byteBuffer coordinates; // Ten millionths of a degree, longitude then latitude
+    dictionaryColumn cities;
+    dictionaryColumn states;
+    dictionaryColumn countries;
+    dictionaryColumn shapes;
+    byteBuffer comments; // Each block is its size, its compressed size, then the compressed comments
+} columnStore;
+
+/**
+ * struct to store the position of a read through every row of a column store
+ */
+typedef struct columnCursor {
+    int row;
+    unsigned char *occurred;
+    unsigned char *reported;
+    unsigned char *durations;
+    unsigned char *coordinates;
+    unsigned char *comments;
+    long long prevOccurred;
+    long long prevReported;
+    char *block; // Comments of the current block, each ended by '\0'
+    char *comment; // Next comment in the block, or NULL if the block was skipped
+    char *blockEnd; // Just past the comments of the current block
+    int blockRows; // Rows left in the current block
+    char *wanted; // Which rows will be used, so blocks without any can be skipped; NULL for every row
+} columnCursor;
+
 /**
  * Prompt the user for input and add an item to the linked list
  * @param head the node to treat as the head and insert a new element before, replacing the head
+ * @param journal journal to record the addition in
+ */
+void addEntry(sightingNode **head, FILE *journal);
+
+/**
+ * Build a trigram index of every distinct city name in the list
+ * @param index
+ * @param head
+ * @param size number of nodes in the list
+ */
+void buildCityIndex(cityIndex *index, sightingNode *head, int size);
+
+/**
+ * Fill a view with every node in the list
+ * @param view
+ * @param head
+ */
+void buildView(viewIndex *view, sightingNode *head);
+
+/**
+ * Hash the fields that identify a sighting: time, city, state, and shape
+ * @param node
+ * @return 64 bit FNV-1a hash
  */
-void addEntry(sightingNode **head);
+unsigned long long dedupKey(sightingNode *node);
 
 /**
  * Recursively free memory for all nodes in the list
@@ -65,6 +376,17 @@ void addEntry(sightingNode **head);
  */
 void freeData(sightingNode *head);
 
+/**
+ * Poll a file for rows appended after the last read row and add them to the list until the user presses return
+ * @param fileName
+ * @param head
+ * @param offset byte offset just past the last read row; updated as new rows are read
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function the active sort function, or NULL if the list is in file order
+ * @return number of rows added
+ */
+int followData(char fileName[], sightingNode **head, long *offset, int dir, compare function);
+
 /**
  * Prompt the user for a date input
  * @param output where to save the input
@@ -72,12 +394,42 @@ void freeData(sightingNode *head);
  */
 void getDateInput(date *output, date defaultDate);
 
+/**
+ * Free the memory for a city index
+ * @param index
+ */
+void freeCityIndex(cityIndex *index);
+
+/**
+ * Free the memory for a view, but not the nodes in it
+ * @param view
+ */
+void freeView(viewIndex *view);
+
 /**
  * Prompt the user for a file name
  * @param fileName
  */
 void getFileName(char fileName[]);
 
+/**
+ * Find the city names closest to a possibly misspelled name, print them, and put every row in one of them in the
+ * results. Candidates come from merging the trigram posting lists, and only the ones sharing enough trigrams to be
+ * within the edit budget are ranked by edit distance.
+ * @param results output view
+ * @param head
+ * @param index
+ * @param city
+ */
+void fuzzyCitySearch(viewIndex *results, sightingNode *head, cityIndex *index, char city[]);
+
+/**
+ * Prompt the user for a number
+ * @param output where to save the input
+ * @param defaultInt
+ */
+void getIntInput(int *output, int defaultInt);
+
 /**
  * Prompt the user for string input
  * @param output where to save the input
@@ -86,698 +438,5110 @@ void getFileName(char fileName[]);
 void getStringInput(char output[], char defaultString[]);
 
 /**
- * Take in a double pointer to head node and change it to point steps spaces ahead of that
+ * Insert a node into a sorted linked list before the first node that sorts after it
+ * @param head
  * @param node
- * @param steps
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function the sort function, or NULL to append to the end
  */
-void lookAhead(sightingNode **node, int steps);
+void insertSorted(sightingNode **head, sightingNode *node, int dir, compare function);
 
 /**
- * Print an array of pointers to nodes
- * @param arr
+ * Append an addition or removal to the journal and make sure it is on disk before returning
+ * @param journal nothing is written if NULL
+ * @param op '+' for an added node, '-' for a removed node
+ * @param node
+ */
+void journalEntry(FILE *journal, char op, sightingNode *node);
+
+/**
+ * Move a run in a merge heap down until it sorts before both of its children
+ * @param heap run numbers
  * @param size
+ * @param i position in the heap of the run to move
+ * @param heads the next node of each run
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function
  */
-void printArray(sightingNode *arr[], int size);
+void mergeSiftDown(int heap[], int size, int i, sightingNode heads[], int dir, compare function);
 
 /**
- * Print a linked list
- * @param head
- * @param maxNodes how many nodes to print
+ * Sort an array of nodes with a stable merge sort
+ * @param rows
+ * @param buffer scratch space the same size as rows
+ * @param size
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function
  */
-void printList(sightingNode *head, int maxNodes);
+void mergeSort(sightingNode **rows, sightingNode **buffer, int size, int dir, compare function);
 
 /**
- * Print a single node
- * @param node
+ * Merge sorted csv files into one sorted output in a single pass, with a heap holding the next row of each file. Rows
+ * that compare equal are taken from the earlier file first, so merging runs of one file in order is stable.
+ * @param runs open files, each sorted by function
+ * @param positions where each run is, to report its rows that could not be read, or NULL for runs written by the sort
+ * @param numRuns
+ * @param output
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function
+ * @return number of rows written
  */
-void printNode(sightingNode *node);
+long mergeRuns(FILE *runs[], csvPosition positions[], int numRuns, FILE *output, int dir, compare function);
 
 /**
- * Read a csv file character by character until encountering a spacer
- * @param csv file to read
- * @param string where to put the read sting
+ * Merge csv files that are each already sorted into one sorted file
+ * @param inNames
+ * @param numFiles
+ * @param outName
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function the function every file is sorted by
+ * @param skipped where to save how many rows could not be read, which are reported by file and line and left out
+ * @return number of rows written, or -1 if a file could not be opened or the output is one of the files
  */
-void readStringToSpacer(FILE *csv, char string[]);
+long mergeFiles(char *inNames[], int numFiles, char outName[], int dir, compare function, int *skipped);
 
 /**
- * Save a single node to a file
- * @param file
- * @param node
+ * Add bytes to the end of a buffer, growing it if needed
+ * @param buffer
+ * @param bytes
+ * @param size
  */
-void saveNode(FILE *file, sightingNode *node);
+void bufferAppend(byteBuffer *buffer, const void *bytes, long size);
 
 /**
- * Search a linked list by a given predicate and put the results in the given array
- * @param results output array
- * @param head node to start search
- * @param predicate function to use
- * @param d date to compare to
+ * Compress the comments collected for a block and add the block to the comment column
+ * @param comments
+ * @param block comments of the block, each ended by '\0'; emptied afterwards
  */
-void searchByDate(sightingNode **results, sightingNode *head, datePredicate predicate, date d);
+void flushCommentBlock(byteBuffer *comments, byteBuffer *block);
 
 /**
- * Search a linked list by a given predicate and put the results in the given array
- * @param results output array
- * @param head node to start search
- * @param predicate function to use
- * @param string string to compare to
+ * Free all memory of a column store
+ * @param store
  */
-void searchByString(sightingNode **results, sightingNode *head, stringPredicate predicate, char string[]);
+void freeColumns(columnStore *store);
 
 /**
- * Sort a linked list by the given comparison function
- * @param head
+ * Compress bytes by replacing repeats with references back to an earlier copy. The output is a list of varint literal
+ * counts with the literals, each followed by the varint length and distance of a repeat, and ending with literals.
+ * @param output
+ * @param input
  * @param size
- * @param dir 1 for increasing, -1 for decreasing
- * @param function
  */
-void sortBy(sightingNode **head, int size, int dir, compare function);
+void lzCompress(byteBuffer *output, unsigned char input[], int size);
 
 /**
- * Return true if the character is contained within the array
- * @param c character to search for
- * @param arr array to search
- * @param len
- * @return 1 if c in arr, 0 otherwise
+ * Start a read through every row of a column store
+ * @param cursor
+ * @param store
+ * @param wanted which rows will be used, or NULL for every row
  */
-int contains(char c, char arr[], int len);
+void openCursor(columnCursor *cursor, columnStore *store, char wanted[]);
 
 /**
- * Return true if the given array contains NULL elements
- * @param arr
- * @return 1 if arr contains NULL, 0 otherwise
+ * Pack the dictionary ids of every row into the fewest bits that fit every id
+ * @param column
+ * @param ids
+ * @param size
  */
-int containsNull(sightingNode *arr[MAX_SEARCH_RESULTS]);
+void packIds(dictionaryColumn *column, int ids[], int size);
 
 /**
- * Load all data from file
- * @param fileName
- * @param head
- * @return integer size of the linked list after loading
+ * Add a buffer to another as its size followed by its bytes
+ * @param output
+ * @param section
  */
-int loadData(char fileName[], sightingNode *head);
+void putBuffer(byteBuffer *output, byteBuffer *section);
 
 /**
- * Prompt the user and remove an entry from the list
- * @param node
- * @return 1 if an entry was removed, 0 otherwise
+ * Add a signed number as a varint: zigzag encoded so small negative numbers stay short, then 7 bits per byte with the
+ * high bit set on every byte but the last
+ * @param buffer
+ * @param value
  */
-int removeEntry(sightingNode **node);
+void putVarint(byteBuffer *buffer, long long value);
 
 /**
- * Save the list to a file
- * @param head
- * @return 1 if the data was saved, 0 otherwise
+ * Get a dictionary column ready to have values added
+ * @param column
+ * @param rows most values there may be
  */
-int saveData(sightingNode *head);
+void startDictionary(dictionaryColumn *column, int rows);
 
-// Comparison and predicate functions
-int dateTimeCompare(sightingNode *n1, sightingNode *n2, int dir);
+/**
+ * Answer one request to the query server
+ * @param server
+ * @param request one line of the protocol, without the newline
+ * @param output where to write the answer, which always ends with a line starting with END or ERROR
+ */
+void answerQuery(queryServer *server, char request[], FILE *output);
 
-int cityCompare(sightingNode *n1, sightingNode *n2, int dir);
+/**
+ * Run a load generator thread: connect to the server and time a mix of queries
+ * @param worker benchWorker to fill in
+ * @return NULL
+ */
+void *benchThread(void *worker);
 
-int stateCompare(sightingNode *n1, sightingNode *n2, int dir);
+/**
+ * Free all memory of a dictionary column
+ * @param column
+ */
+void freeDictionary(dictionaryColumn *column);
 
-int countryCompare(sightingNode *n1, sightingNode *n2, int dir);
+/**
+ * Answer the requests of one connection to the query server until it closes
+ * @param connection serverConnection, freed when done
+ * @return NULL
+ */
+void *serveConnection(void *connection);
 
-int shapeCompare(sightingNode *n1, sightingNode *n2, int dir);
+/**
+ * Join the clusters of two core rows
+ * @param parent union find forest
+ * @param a
+ * @param b
+ */
+void clusterUnion(atomic_int parent[], int a, int b);
 
-int durationCompare(sightingNode *n1, sightingNode *n2, int dir);
+/**
+ * Run one pass over a share of the rows of a cluster grid; used as a thread's start routine
+ * @param work the clusterWork to do
+ * @return NULL
+ */
+void *clusterThread(void *work);
 
-int dateReportedCompare(sightingNode *n1, sightingNode *n2, int dir);
+/**
+ * Print the summary of a cluster
+ * @param id
+ * @param summary
+ */
+void printCluster(int id, clusterSummary *summary);
 
-int cityPredicate(sightingNode *node, char *city);
+/**
+ * Find the count, centroid, time span, and most common shape of every cluster
+ * @param view rows that were clustered
+ * @param labels cluster of each row, from findClusters
+ * @param numClusters
+ * @param summaries output, one for each cluster
+ */
+void summarizeClusters(viewIndex *view, int labels[], int numClusters, clusterSummary summaries[]);
 
-int statePredicate(sightingNode *node, char *state);
+/**
+ * Put the rows of every cluster in a view, largest cluster first, keeping the order of the rows within a cluster
+ * @param results output view
+ * @param view rows that were clustered
+ * @param labels cluster of each row, from findClusters
+ * @param numClusters
+ */
+void viewClusters(viewIndex *results, viewIndex *view, int labels[], int numClusters);
 
-int countryPredicate(sightingNode *node, char *country);
+/**
+ * Add a field that refers to an object to the current table
+ * @param builder
+ * @param slot field number in the schema
+ * @param offset the object, as returned when it was finished
+ */
+void flatAddOffset(flatBuilder *builder, int slot, long offset);
 
-int shapePredicate(sightingNode *node, char *shape);
+/**
+ * Add a little endian scalar field to the current table
+ * @param builder
+ * @param slot field number in the schema
+ * @param value
+ * @param size bytes in the field
+ */
+void flatAddScalar(flatBuilder *builder, int slot, long long value, int size);
 
-int dateOccurredPredicate(sightingNode *node, date d);
+/**
+ * Finish a flatbuffer with a reference to its root table at the start
+ * @param builder
+ * @param root
+ */
+void flatFinish(flatBuilder *builder, long root);
 
-int dateReportedPredicate(sightingNode *node, date d);
+/**
+ * Pad the front of a flatbuffer so that after adding more bytes, the front is aligned
+ * @param builder
+ * @param align
+ * @param additional bytes that will be added next
+ */
+void flatPrep(flatBuilder *builder, int align, long additional);
 
-char menu(char message[], char optionsText[][MAX_MENU_OPTION], char options[], int numOptions, int defaultOption);
+/**
+ * Add bytes to the front of a flatbuffer, growing it if needed
+ * @param builder
+ * @param bytes
+ * @param size
+ */
+void flatPush(flatBuilder *builder, const void *bytes, long size);
 
-sightingNode *swapNodes(sightingNode *ptr1, sightingNode *ptr2);
+/**
+ * Add a little endian number to the front of a flatbuffer without aligning it
+ * @param builder
+ * @param value
+ * @param size bytes to add
+ */
+void flatPushScalar(flatBuilder *builder, long long value, int size);
 
-int main(void) {
-    // DECLARE MENUS
-    char menuInput;
-    char mainMenu[][MAX_MENU_OPTION] = {"View more (default)", "Sort", "Filter", "Return to top", "Add", "Delete",
-                                        "Save",
-                                        "Quit"};
-    char mainMenuOptions[] = {'v', 'o', 'f', 'c', 'a', 'r', 's', 'q'};
-    char sortMenu[][MAX_MENU_OPTION] = {"Date (default)", "City", "State", "Country", "Shape", "Duration",
-                                        "Date reported",
-                                        "Reverse sorting"};
-    char sortMenuOptions[] = {'d', 't', 's', 'c', 'h', 'u', 'p', 'r'};
-    char filterMenu[][MAX_MENU_OPTION] = {"Date", "City", "State", "Country", "Shape", "Date Reported",
-                                          "Reset (default)"};
-    char filterMenuOptions[] = {'d', 't', 's', 'c', 'h', 'p', 'r'};
-    char openMenu[][MAX_MENU_OPTION] = {"Continue to file name entry?"};
-    char openMenuOptions[] = {'e', 'd'};
+/**
+ * Start a table; its fields are added next, after any objects they refer to
+ * @param builder
+ */
+void flatStartTable(flatBuilder *builder);
 
-    // DECLARE OTHER VARIABLES
-    int size;
-    int viewingLocation = 0; // What index of the list is the user looking at
-    int prevSearchType; // 0 = date; 1 = string
-    int sortDir = 1;
-    int state = 3; // 0 = exiting; 1 = normal viewing; 2 = filtered viewing, 3 = opening data
-    char fileName[50] = "../sample.csv"; // Starts with default directory
-    compare prevSort = dateTimeCompare; // Last used sort function
-    datePredicate prevDateSearch; // Last used date filter
-    stringPredicate prevStringSearch; // Last used string filter
-    char prevStringSearchString[50] = "hanover"; // Last used string filter text
-    date prevDateSearchDate = {2004, 12, 18}; // Last used date filter date
+/**
+ * Add an Arrow buffer to the layout of a message body, aligned to 8 bytes
+ * @param buffers offset and length of every buffer so far
+ * @param numBuffers
+ * @param bodyLength length of the body so far; updated
+ * @param length
+ */
+void arrowBuffer(long long buffers[], int *numBuffers, long long *bodyLength, long long length);
 
-    sightingNode *headNode = malloc(sizeof(sightingNode));
-    sightingNode *viewingNode = headNode;
-    sightingNode *searchResults[MAX_SEARCH_RESULTS]; // Search results for filter views
+/**
+ * Write zeros to pad a file position to a multiple of 8
+ * @param file
+ * @param length bytes written since the last multiple of 8
+ */
+void arrowPad(FILE *file, long long length);
 
-    printf(WELCOME);
+/**
+ * Write the offsets and bytes of a string column in Arrow's layout, each padded to 8 bytes
+ * @param file
+ * @param strings
+ * @param count
+ */
+void arrowWriteStrings(FILE *file, char *strings[], int count);
 
-    // Opening file
-    menuInput = menu("Load data set (press return to use default)", openMenu, openMenuOptions,
-                     sizeof(openMenu) / sizeof(openMenu[0]), 1);
-    if (menuInput == 'e')
-        getFileName(fileName); // Prompt the user for a file name
-    else
-        printf("Using default file name %s\n", fileName);
-    size = loadData(fileName, headNode);
-    viewingNode = headNode;
-    printList(viewingNode, MAX_SEARCH_RESULTS);
-    if (viewingLocation + 10 >= size) // If they are viewing the last 10 (or fewer) items, indicate that
-        printf("End of data\n");
-    state = 1;
+/**
+ * Write a text field to a csv, in quotes with its quotes doubled if it has a comma, quote, or line break
+ * @param file
+ * @param field
+ */
+void saveField(FILE *file, char field[]);
 
-    while (state) {
-        menuInput = menu("Main Menu", mainMenu, mainMenuOptions, sizeof(mainMenu) / sizeof(mainMenu[0]), 0);
-        switch (menuInput) {
-            case 'v': // View (i.e. show the next ten elements)
-                if (state == 2) { // If in filtered view, proceed with array
-                    if (!containsNull(searchResults) &&
-                        searchResults[9]->next != NULL) { // If there is more data to come
-                        if (prevSearchType) { // Depending on the search type, difference predicate signatures are required
-                            lookAhead(&searchResults[9], MAX_SEARCH_RESULTS);
-                            searchByString(searchResults, searchResults[9], prevStringSearch, prevStringSearchString);
-                        } else {
-                            lookAhead(&searchResults[9], MAX_SEARCH_RESULTS);
-                            searchByDate(searchResults, searchResults[9], prevDateSearch, prevDateSearchDate);
-                        }
-                    } else { // Inform the user if they are at the end
-                        printf("You are already viewing the end of the data. Try 'c' to return to the top\n");
-                        break;
-                    }
-                    printArray(searchResults, MAX_SEARCH_RESULTS);
-                    if (containsNull(searchResults) || searchResults[9]->next == NULL)
-                        printf("End of data\n"); // If they are viewing the last 10 (or fewer) items, indicate that
-                } else { // If in regular view, simply move up 10 spaces in the linked list
-                    if (viewingLocation + 10 >=
-                        size) { // If they are viewing the last 10 (or fewer) items, indicate that
-                        printf("You are already viewing the end of the data. Try 'c' to return to the top\n");
-                        break;
-                    }
-                    lookAhead(&viewingNode, MAX_SEARCH_RESULTS);
-                    viewingLocation += 10;
-                    printList(viewingNode, MAX_SEARCH_RESULTS);
-                    if (viewingLocation + 10 >= size) // If they are viewing the last 10 (or fewer) items, indicate that
-                        printf("End of data\n");
-                }
-                break;
-            case 'o': // Sort option
-                menuInput = menu("Sorting Menu", sortMenu, sortMenuOptions,
-                                 sizeof(sortMenu) / sizeof(sortMenu[0]), 0);
-                switch (menuInput) { // Set the proper comparison function depending on user input
-                    case 'd':
-                        prevSort = dateTimeCompare;
-                        break;
-                    case 't':
-                        prevSort = cityCompare;
-                        break;
-                    case 's':
-                        prevSort = stateCompare;
-                        break;
-                    case 'c':
-                        prevSort = countryCompare;
-                        break;
-                    case 'h':
-                        prevSort = shapeCompare;
-                        break;
-                    case 'u':
-                        prevSort = durationCompare;
-                        break;
-                    case 'p':
-                        prevSort = dateReportedCompare;
-                        break;
-                    default: // r = reverse
-                        sortDir *= -1;
-                }
-                // Sort and print
+/**
+ * Handle a signal to stop the query server. It only has to interrupt accept, so it does nothing itself.
+ * @param number
+ */
+void stopSignal(int number);
+
+/**
+ * Offer a row to a bounded heap, keeping it only if it sorts before the worst row kept so far
+ * @param heap
+ * @param index index of the row in the view
+ */
+void heapOffer(topKHeap *heap, int index);
+
+/**
+ * Move the root of a heap down until both of its children sort before it
+ * @param heap
+ */
+void heapSiftDown(topKHeap *heap);
+
+/**
+ * Add a string to a 64 bit FNV-1a hash
+ * @param hash hash so far; start with FNV_OFFSET
+ * @param string
+ * @return the new hash
+ */
+unsigned long long hashString(unsigned long long hash, char string[]);
+
+/**
+ * Print an array of pointers to nodes
+ * @param arr
+ * @param size
+ */
+void printArray(sightingNode *arr[], int size);
+
+/**
+ * Print the page of a view that starts at the given row
+ * @param view
+ * @param location index of the first row to print
+ */
+void printPage(viewIndex *view, int location);
+
+/**
+ * Print a single node
+ * @param node
+ */
+void printNode(sightingNode *node);
+
+/**
+ * Save every node of a list to a file, one per line
+ * @param file
+ * @param head
+ */
+void saveList(FILE *file, sightingNode *head);
+
+/**
+ * Save a single node to a file
+ * @param file
+ * @param node
+ */
+void saveNode(FILE *file, sightingNode *node);
+
+/**
+ * Search a linked list by a given predicate and put every result in the given view
+ * @param results output view
+ * @param head node to start search
+ * @param cache filter cache to use and update
+ * @param predicate function to use
+ * @param d date to compare to
+ */
+void searchByDate(viewIndex *results, sightingNode *head, filterCache *cache, datePredicate predicate, date d);
+
+/**
+ * Search a linked list by a given predicate and put every result in the given view
+ * @param results output view
+ * @param head node to start search
+ * @param cache filter cache to use and update
+ * @param predicate function to use
+ * @param string string to compare to
+ */
+void searchByString(viewIndex *results, sightingNode *head, filterCache *cache, stringPredicate predicate,
+                    char string[]);
+
+/**
+ * Put every row of a cached filter in the given view, in list order, giving the ids again first if the list has changed
+ * @param results output view
+ * @param head
+ * @param cache
+ * @param entry the filter to show
+ * @param fresh 1 if the entry was just made, so every row has to be checked
+ */
+void searchCached(viewIndex *results, sightingNode *head, filterCache *cache, filterCacheEntry *entry, int fresh);
+
+/**
+ * Give every row an id in list order, moving each entry's bits to the new ids and checking rows the cache has not seen
+ * @param cache
+ * @param head
+ * @param fresh entry that was just made, so every row has to be checked against it, or NULL
+ */
+void renumberFilters(filterCache *cache, sightingNode *head, filterCacheEntry *fresh);
+
+/**
+ * Set the bit for a row in a filter cache entry, growing the bitmap if needed
+ * @param entry
+ * @param id
+ * @param value
+ */
+void setFilterBit(filterCacheEntry *entry, int id, int value);
+
+/**
+ * Compute a SimHash of a comment, so comments that share most of their words get hashes that differ in only a few bits
+ * @param comment
+ * @return 64 bit SimHash
+ */
+unsigned long long simHash(char comment[]);
+
+/**
+ * Sort a linked list by the given comparison function, using a stable merge sort
+ * @param head
+ * @param size
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function
+ */
+void sortBy(sightingNode **head, int size, int dir, compare function);
+
+/**
+ * Find the k rows of a view that sort first and put them in order in the results, in O(n log k) time. Large views are
+ * split between threads that each keep their own heap, and the heaps are merged at the end.
+ * @param results output view
+ * @param view rows to search
+ * @param k
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function
+ */
+void topK(viewIndex *results, viewIndex *view, int k, int dir, compare function);
+
+/**
+ * Offer every row in a heap's range to it; used as a thread's start routine
+ * @param heap the topKHeap to fill
+ * @return NULL
+ */
+void *topKThread(void *heap);
+
+/**
+ * Add a node to the end of a view, making room if needed
+ * @param view
+ * @param node
+ */
+void viewAppend(viewIndex *view, sightingNode *node);
+
+/**
+ * Return true if one row of a view sorts before another. Equal rows keep their order in the view, like sortBy.
+ * @param rows
+ * @param a index of the first row
+ * @param b index of the second row
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function
+ * @return 1 if row a comes first, 0 otherwise
+ */
+int sortsBefore(sightingNode **rows, int a, int b, int dir, compare function);
+
+/**
+ * Compress a list into a column store
+ * @param store output store
+ * @param head
+ * @return number of rows left out because their dates could not be encoded
+ */
+int compressData(columnStore *store, sightingNode *head);
+
+/**
+ * Get how many bytes a column store uses in memory
+ * @param store
+ * @return
+ */
+long columnBytes(columnStore *store);
+
+/**
+ * Get a number for a date that increases with the date
+ * @param d
+ * @return the number, or -1 if a part of the date is out of range
+ */
+long long dateKey(date d);
+
+/**
+ * Get the id of a value in a dictionary column, adding it if it is new
+ * @param column
+ * @param value
+ * @return
+ */
+int dictionaryId(dictionaryColumn *column, char value[]);
+
+/**
+ * Read a buffer added by putBuffer
+ * @param cursor moved past the buffer
+ * @param end end of the input
+ * @param section output buffer
+ * @return 1 if the buffer was read, 0 if the input is too short
+ */
+int getBuffer(unsigned char **cursor, unsigned char *end, byteBuffer *section);
+
+/**
+ * Read a varint added by putVarint
+ * @param cursor moved past the varint
+ * @return
+ */
+long long getVarint(unsigned char **cursor);
+
+/**
+ * Load a column store saved by saveColumns
+ * @param fileName
+ * @param store
+ * @return 1 if the file was loaded, 0 otherwise
+ */
+int loadColumns(char fileName[], columnStore *store);
+
+/**
+ * Save a column store to a file
+ * @param fileName
+ * @param store
+ * @return 1 if the file was saved, 0 otherwise
+ */
+int saveColumns(char fileName[], columnStore *store);
+
+/**
+ * Filter a column store without decoding the rows. Date filters scan only the date column, and text filters run the
+ * predicate once per distinct value and then only compare ids.
+ * @param store
+ * @param field a letter from the filter menu
+ * @param value text or MM/DD/YYYY date to filter by
+ * @param wanted output with 1 for every matching row
+ * @return number of matching rows, or -1 if the field or date is not valid
+ */
+int searchColumns(columnStore *store, char field, char value[], char wanted[]);
+
+/**
+ * Get the dictionary id of a row
+ * @param column
+ * @param row
+ * @return
+ */
+int unpackId(dictionaryColumn *column, int row);
+
+/**
+ * Decode rows of a column store into a csv file
+ * @param store
+ * @param file
+ * @param wanted which rows to write, or NULL for every row
+ * @return number of rows written
+ */
+long writeColumns(columnStore *store, FILE *file, char wanted[]);
+
+/**
+ * Find the cache entry for a filter, or replace the least recently used entry with an empty one for it
+ * @param cache
+ * @param stringSearch NULL for a date filter
+ * @param string
+ * @param dateSearch NULL for a string filter
+ * @param d
+ * @param fresh set to 1 if the entry is new
+ * @return the entry
+ */
+filterCacheEntry *findFilter(filterCache *cache, stringPredicate stringSearch, char string[], datePredicate dateSearch,
+                             date d, int *fresh);
+
+/**
+ * Check if a row matches the filter of a cache entry
+ * @param entry
+ * @param node
+ * @return 1 if it matches, 0 otherwise
+ */
+int filterMatches(filterCacheEntry *entry, sightingNode *node);
+
+/**
+ * Run the load generator against a query server and print queries per second and latency percentiles
+ * @param socketName
+ * @param threads number of connections to make at once
+ * @param queries number of queries for each connection
+ * @return 1 if every query was answered, 0 otherwise
+ */
+int benchServer(char socketName[], int threads, int queries);
+
+/**
+ * Connect to a query server
+ * @param socketName
+ * @return the socket, or -1 if the server could not be reached
+ */
+int connectServer(char socketName[]);
+
+/**
+ * qsort comparison for pairs of a count and an id, largest count first
+ * @param a
+ * @param b
+ * @return
+ */
+int countCompare(const void *a, const void *b);
+
+/**
+ * qsort comparison for latencies, smallest first
+ * @param a
+ * @param b
+ * @return
+ */
+int latencyCompare(const void *a, const void *b);
+
+/**
+ * Send one request to a query server and read the answer
+ * @param request one line of the protocol, ended by a newline
+ * @param input read side of the connection
+ * @param output write side of the connection
+ * @param answer where to copy the answer, or NULL to discard it
+ * @return 1 if the answer ended with END, 0 for an error or a closed connection
+ */
+int queryServerOnce(char request[], FILE *input, FILE *output, FILE *answer);
+
+/**
+ * Send requests from standard input to a query server and print the answers
+ * @param socketName
+ * @return 1 if the server could be reached, 0 otherwise
+ */
+int runClient(char socketName[]);
+
+/**
+ * Load a file once and answer queries about it on a Unix socket until the process is stopped
+ * @param fileName
+ * @param socketName
+ * @return 0 if the server could not start
+ */
+int serveData(char fileName[], char socketName[]);
+
+/**
+ * Get the time from a clock that only moves forward, for measuring how long something takes
+ * @return seconds
+ */
+double secondsNow(void);
+
+/**
+ * Get the key of a grid cell for the cluster grid's hash table
+ * @param latCell
+ * @param lonCell
+ * @param timeCell
+ * @return
+ */
+long long cellKey(int latCell, int lonCell, int timeCell);
+
+/**
+ * Get the approximate distance between two rows of a cluster grid. At cluster sizes the earth is flat enough that
+ * scaling the longitude difference by the cosine of the latitude is accurate.
+ * @param grid
+ * @param a
+ * @param b
+ * @return kilometers
+ */
+double clusterDistance(clusterGrid *grid, int a, int b);
+
+/**
+ * Find the root of a core row's cluster
+ * @param parent union find forest
+ * @param i
+ * @return
+ */
+int clusterRoot(atomic_int parent[], int i);
+
+/**
+ * Get the number of days from 1/1/1970 to a date
+ * @param d
+ * @return
+ */
+long dayNumber(date d);
+
+/**
+ * Find clusters of sightings close together in space and time with DBSCAN. A row with at least minPoints rows within
+ * reach, counting itself, is a core row; core rows within reach of each other share a cluster, and other rows join
+ * the cluster of a core row within reach. The passes over the rows are split between threads.
+ * @param view rows to cluster
+ * @param distance most kilometers between two rows within reach
+ * @param days most days between two rows within reach
+ * @param minPoints
+ * @param labels output with the cluster of each row, 1 for the largest cluster and up, or 0 if it is in none
+ * @return number of clusters
+ */
+int findClusters(viewIndex *view, int distance, int days, int minPoints, int labels[]);
+
+/**
+ * Find the slot of a cell in a cluster grid's hash table
+ * @param grid
+ * @param key
+ * @param add 1 to claim an empty slot if the cell is not there
+ * @return the slot, or -1 if the cell is not there
+ */
+int gridCell(clusterGrid *grid, long long key, int add);
+
+/**
+ * Build the Arrow metadata table for one field
+ * @param builder
+ * @param name
+ * @param typeType Arrow Type union number
+ * @param type the type table
+ * @param dictionary dictionary id, or -1 if the field is not dictionary encoded
+ * @return the field table
+ */
+long arrowField(flatBuilder *builder, char name[], int typeType, long type, int dictionary);
+
+/**
+ * Build an Arrow message around a record batch
+ * @param builder
+ * @param dictionary dictionary id to make a dictionary batch, or -1 for a plain record batch
+ * @param length rows in the batch
+ * @param nodes length and null count of every column
+ * @param numNodes
+ * @param buffers offset and length of every buffer in the body
+ * @param numBuffers
+ * @param bodyLength
+ * @return the message table
+ */
+long arrowRecordBatch(flatBuilder *builder, int dictionary, long long length, long long nodes[], int numNodes,
+                      long long buffers[], int numBuffers, long long bodyLength);
+
+/**
+ * Build the Arrow schema of a sighting: a timestamp, four dictionary encoded strings, a duration, a comment, a date,
+ * and the coordinates
+ * @param builder
+ * @return the schema table
+ */
+long arrowSchema(flatBuilder *builder);
+
+/**
+ * Write a finished flatbuffer as an Arrow message: a continuation marker, the padded length, then the metadata
+ * @param file
+ * @param builder
+ * @return bytes written
+ */
+long arrowWriteMessage(FILE *file, flatBuilder *builder);
+
+/**
+ * Write the rows of a view to an Apache Arrow IPC file. Text columns other than the comment are dictionary encoded,
+ * the date and time becomes a timestamp in seconds, and the date reported a date. The body is written one column at a
+ * time through a large buffer.
+ * @param fileName
+ * @param view
+ * @return 1 if the file was written, 0 otherwise
+ */
+int exportArrow(char fileName[], viewIndex *view);
+
+/**
+ * Finish the current table
+ * @param builder
+ * @return the table
+ */
+long flatEndTable(flatBuilder *builder);
+
+/**
+ * Add a vector of structs made of 8 byte values, which is how Arrow's nodes, buffers, and blocks are laid out
+ * @param builder
+ * @param values
+ * @param count structs in the vector
+ * @param width values in each struct
+ * @return the vector
+ */
+long flatLongVector(flatBuilder *builder, long long values[], int count, int width);
+
+/**
+ * Add a vector of references to objects
+ * @param builder
+ * @param offsets
+ * @param count
+ * @return the vector
+ */
+long flatOffsetVector(flatBuilder *builder, long offsets[], int count);
+
+/**
+ * Add a string
+ * @param builder
+ * @param string
+ * @return the string
+ */
+long flatString(flatBuilder *builder, char string[]);
+
+/**
+ * Stage two of reading csv: copy one field into a string. A field in quotes has them removed and its doubled quotes
+ * made single. Anything past the size of the string is dropped.
+ * @param start first byte of the field
+ * @param end the comma or line break after the field
+ * @param string output
+ * @param max size of the string
+ * @return 1 if the field was copied, 0 if it has a quote out of place
+ */
+int copyField(char *start, char *end, char string[], int max);
+
+/**
+ * Stage two of reading csv: convert the fields of one row into a node, using the field ends found by scanStructure
+ * @param buffer
+ * @param start position of the first byte of the row
+ * @param ends positions from scanStructure, starting with the first in the row
+ * @param count positions in ends
+ * @param node output
+ * @param error output, set to what is wrong with the row or to an empty string if nothing is
+ * @return positions used by the row, or 0 if the row does not end within them
+ */
+int convertRow(char buffer[], int start, int ends[], int count, sightingNode *node, char error[]);
+
+/**
+ * Read whole numbers with the given character after each but the last, such as "//" for a date, faster than sscanf
+ * @param text
+ * @param separators
+ * @param values output, one more than there are separators
+ * @return 1 if every number was read, 0 otherwise
+ */
+int readNumbers(char text[], char separators[], int values[]);
+
+/**
+ * Read one row of a csv, which is more than one line if a quoted field has line breaks in it, growing the buffer to
+ * fit however long the row is
+ * @param file
+ * @param line buffer to read into, which may be NULL, and is reallocated as needed
+ * @param capacity size of the buffer, updated when it grows
+ * @param open set to 1 if the row ended inside a quoted field
+ * @return length of the row, or 0 at the end of the file
+ */
+int readRecord(FILE *file, char **line, int *capacity, int *open);
+
+/**
+ * Stage one of reading csv: find where every field ends in a buffer, 64 bytes at a time
+ * @param buffer
+ * @param length
+ * @param ends output positions of the commas and line breaks that end fields, in order. Line breaks inside quoted
+ * fields are also given, as ~position, so rows can be matched to lines of the file.
+ * @param max most positions to find
+ * @return number of positions found
+ */
+int scanStructure(char buffer[], int length, int ends[], int max);
+
+/**
+ * Find the commas and line breaks in 64 bytes of csv that end fields, leaving out those inside quoted fields
+ * @param block 64 bytes
+ * @param quoted all ones if the block starts inside a quoted field, 0 otherwise; updated for the next block
+ * @param breaks output bit for each line break inside a quoted field
+ * @return a bit for each byte that ends a field
+ */
+unsigned long long scanBlock(const char block[], unsigned long long *quoted, unsigned long long *breaks);
+
+/**
+ * Check that every column of a loaded store holds a value for each row within its bytes, and that every block of
+ * comments fits
+ * @param store
+ * @return 1 if the store is whole, 0 otherwise
+ */
+int checkColumns(columnStore *store);
+
+/**
+ * Check that a buffer holds at least the given number of varints
+ * @param section
+ * @param count
+ * @return 1 if it does, 0 otherwise
+ */
+int checkVarints(byteBuffer *section, long count);
+
+/**
+ * Undo lzCompress, stopping at anything that would go past the input or output
+ * @param input
+ * @param inputSize
+ * @param output
+ * @param size size of the uncompressed bytes
+ * @return bytes written to the output, which is less than size if the input is damaged
+ */
+int lzDecompress(unsigned char input[], int inputSize, unsigned char output[], int size);
+
+/**
+ * Decode the next row of a column store
+ * @param store
+ * @param cursor
+ * @param node output node; the comment is empty if its block was skipped
+ * @return 1 if the row was read, 0 if its block of comments is damaged
+ */
+int readColumns(columnStore *store, columnCursor *cursor, sightingNode *node);
+
+/**
+ * Rewrite the data file with the whole list and empty the journal, since the file now includes its changes
+ * @param fileName data file
+ * @param head
+ * @param journal the open journal; reopened empty
+ * @param offset where to save the byte offset of the end of the new file
+ * @return 1 if the data was compacted, 0 otherwise
+ */
+int compactData(char fileName[], sightingNode *head, FILE **journal, long *offset);
+
+/**
+ * Find the id of a city name in a city index, adding the name if it is new
+ * @param index
+ * @param city
+ * @param add 1 to add the name if it is not there
+ * @return the id, or -1 if the name is not there and was not added
+ */
+int cityId(cityIndex *index, char city[], int add);
+
+/**
+ * Return true if the character is contained within the array
+ * @param c character to search for
+ * @param arr array to search
+ * @param len
+ * @return 1 if c in arr, 0 otherwise
+ */
+int contains(char c, char arr[], int len);
+
+/**
+ * Count the single character insertions, deletions, and substitutions needed to turn one string into another
+ * @param s1
+ * @param s2
+ * @return the Levenshtein distance
+ */
+int editDistance(char s1[], char s2[]);
+
+/**
+ * Sort a csv file that may not fit in memory. Runs that fit in the memory limit are sorted with mergeSort and spilled
+ * to temporary files, then the runs are merged into the output. Every MAX_MERGE_WAYS runs are merged into one early.
+ * The output is the same as loading the whole file, sorting it, and saving it.
+ * @param inName
+ * @param outName
+ * @param dir 1 for increasing, -1 for decreasing
+ * @param function
+ * @param memoryLimit most bytes to use for rows at once
+ * @return 1 if the file was sorted, 0 otherwise
+ */
+int externalSort(char inName[], char outName[], int dir, compare function, long memoryLimit);
+
+/**
+ * Find duplicate sightings in linear time by hashing: the same time, city, state, and shape, with comments whose
+ * SimHashes differ by at most DEDUP_MAX_DISTANCE bits. The first sighting of each group is the one kept.
+ * @param head
+ * @param remove 1 to remove the duplicates, 0 to print each group of duplicates
+ * @param journal journal to record removals in, or NULL
+ * @return number of duplicates found
+ */
+int dedupData(sightingNode **head, int remove, FILE *journal);
+
+/**
+ * Load all data from file
+ * @param fileName
+ * @param head
+ * @param offset where to save the byte offset just past the last read row
+ * @param requireNewline 1 to leave a last row with no newline unread, the same as readNode, since it may still be
+ * being written
+ * @return integer size of the linked list after loading
+ */
+int loadData(char fileName[], sightingNode *head, long *offset, int requireNewline);
+
+/**
+ * Read a last row with no newline that loadData left unread
+ * @param fileName
+ * @param offset where loadData stopped
+ * @param node output
+ * @return 1 if there was a row, 0 otherwise
+ */
+int readLastRow(char fileName[], long offset, sightingNode *node);
+
+/**
+ * Lowercase a city name, turn punctuation into single spaces, and drop notes in parentheses like "(near)"
+ * @param city
+ * @param output
+ * @return length of the output
+ */
+int normalizeCity(char city[], char output[]);
+
+/**
+ * Return true if two nodes hold the same sighting
+ * @param n1
+ * @param n2
+ * @return 1 if every field matches, 0 otherwise
+ */
+int nodeEquals(sightingNode *n1, sightingNode *n2);
+
+/**
+ * Parse a single csv row into a node
+ * @param line
+ * @param node
+ * @return 1 if the row was parsed, 0 otherwise
+ */
+int parseNode(char line[], sightingNode *node);
+
+/**
+ * Parse a single csv row into a node, saying what is wrong with it if it can't be
+ * @param line
+ * @param node
+ * @param error output, MAX_LINE long
+ * @return 1 if the row was parsed, 0 otherwise
+ */
+int parseRecord(char line[], sightingNode *node, char error[]);
+
+/**
+ * Read the next row of a csv file into a node, skipping blank lines
+ * @param csv
+ * @param node
+ * @param requireNewline 1 to leave a last line with no newline unread, since it may still be being written
+ * @param position where the file is, to report a row that could not be parsed by line and count it, or NULL to not
+ * @return 1 if a node was read, 0 at the end of the file, -1 if the line could not be parsed
+ */
+int readNode(FILE *csv, sightingNode *node, int requireNewline, csvPosition *position);
+
+/**
+ * Get the number of a trigram from the position in a normalized name where it starts
+ * @param s
+ * @return index from 0 to TRIGRAMS - 1
+ */
+int trigram(char s[]);
+
+/**
+ * Apply the additions and removals recorded in a journal to the list
+ * @param journalName
+ * @param head
+ * @return how much the size of the list changed by
+ */
+int replayJournal(char journalName[], sightingNode **head);
+
+/**
+ * Run a command given on the command line instead of the interactive viewer
+ * @param argc
+ * @param argv
+ * @return exit status for the program
+ */
+int runBatch(int argc, char *argv[]);
+
+/**
+ * Prompt the user and remove an entry on the current page from the list and the view
+ * @param head
+ * @param view
+ * @param location index of the first row on the page
+ * @param journal journal to record the removal in
+ * @return 1 if an entry was removed, 0 otherwise
+ */
+int removeEntry(sightingNode **head, viewIndex *view, int location, FILE *journal);
+
+/**
+ * Save the list to a file. Saving over the loaded data file compacts it, so its journal is started again.
+ * @param head
+ * @param dataName name of the loaded data file
+ * @param journal journal of the data file
+ * @param offset where to save the byte offset just past the last row if the data file is saved
+ * @return 1 if the data was saved, 0 otherwise
+ */
+int saveData(sightingNode *head, char dataName[], FILE **journal, long *offset);
+
+/**
+ * Check if two paths name the same file
+ * @param name1
+ * @param name2
+ * @return 1 if both files exist and are the same file, 0 otherwise
+ */
+int sameFile(char name1[], char name2[]);
+
+// Comparison and predicate functions
+int dateTimeCompare(sightingNode *n1, sightingNode *n2, int dir);
+
+int cityCompare(sightingNode *n1, sightingNode *n2, int dir);
+
+int stateCompare(sightingNode *n1, sightingNode *n2, int dir);
+
+int countryCompare(sightingNode *n1, sightingNode *n2, int dir);
+
+int shapeCompare(sightingNode *n1, sightingNode *n2, int dir);
+
+int durationCompare(sightingNode *n1, sightingNode *n2, int dir);
+
+int dateReportedCompare(sightingNode *n1, sightingNode *n2, int dir);
+
+int cityPredicate(sightingNode *node, char *city);
+
+int statePredicate(sightingNode *node, char *state);
+
+int countryPredicate(sightingNode *node, char *country);
+
+int shapePredicate(sightingNode *node, char *shape);
+
+int dateOccurredPredicate(sightingNode *node, date d);
+
+int dateReportedPredicate(sightingNode *node, date d);
+
+char menu(char message[], char optionsText[][MAX_MENU_OPTION], char options[], int numOptions, int defaultOption);
+
+/**
+ * Get the comparison function for an option from the sorting menu
+ * @param option
+ * @param prevSort function to keep if the option is to reverse
+ * @param dir flipped if the option is to reverse
+ * @return the comparison function
+ */
+compare sortFunction(char option, compare prevSort, int *dir);
+
+/**
+ * Get the comparison function for a field given on the command line: a letter from the sorting menu, capital to sort
+ * in decreasing order
+ * @param field
+ * @param dir where to save the direction
+ * @return the comparison function, or NULL if the field is not valid
+ */
+compare parseSortField(char field[], int *dir);
+
+int main(int argc, char *argv[]) {
+    // DECLARE MENUS
+    char menuInput;
+    char mainMenu[][MAX_MENU_OPTION] = {"View more (default)", "View previous", "Sort", "Filter", "Return to top",
+                                        "Jump to page or row", "Top results", "Add", "Delete",
+                                        "Find duplicates", "Find clusters", "Export view to Arrow", "Save",
+                                        "Follow file for new data", "Compact changes into file", "Quit"};
+    char mainMenuOptions[] = {'v', 'b', 'o', 'f', 'c', 'j', 't', 'a', 'r', 'd', 'g', 'x', 's', 'l', 'k', 'q'};
+    char sortMenu[][MAX_MENU_OPTION] = {"Date (default)", "City", "State", "Country", "Shape", "Duration",
+                                        "Date reported",
+                                        "Reverse sorting"};
+    char sortMenuOptions[] = {'d', 't', 's', 'c', 'h', 'u', 'p', 'r'};
+    char filterMenu[][MAX_MENU_OPTION] = {"Date", "City", "City (typo tolerant)", "State", "Country", "Shape",
+                                          "Date Reported", "Reset (default)"};
+    char filterMenuOptions[] = {'d', 't', 'z', 's', 'c', 'h', 'p', 'r'};
+    char jumpMenu[][MAX_MENU_OPTION] = {"Page", "Row", "Last page (default)"};
+    char jumpMenuOptions[] = {'p', 'w', 'e'};
+    char dedupMenu[][MAX_MENU_OPTION] = {"List duplicates (default)", "Remove duplicates"};
+    char dedupMenuOptions[] = {'l', 'r'};
+    char openMenu[][MAX_MENU_OPTION] = {"Continue to file name entry?", "Merge sorted files and open the result"};
+    char openMenuOptions[] = {'e', 'm', 'd'};
+
+    // DECLARE OTHER VARIABLES
+    int size;
+    int added; // How many rows were added by following the file
+    int duplicates; // How many duplicate rows were found
+    int citiesStale = 1; // Whether rows were added since the city index was built
+    int hasUnfinished = 0; // Whether unfinished is in the list
+    int jump; // Page or row number to jump to
+    int topCount = 20; // Last used number of top results
+    int numFiles; // How many files to merge
+    int skipped; // Rows of the files to merge that could not be read, which mergeFiles reports
+    int clusterDistanceKm = CLUSTER_DISTANCE_KM; // Last used cluster settings
+    int clusterDays = CLUSTER_DAYS;
+    int clusterMin = CLUSTER_MIN_SIGHTINGS;
+    int numClusters;
+    int *labels; // Cluster of each row
+    clusterSummary *summaries;
+    int i;
+    long fileOffset; // Byte offset just past the last row read from the file
+    int viewingLocation = 0; // What index of the view is the user looking at
+    int prevSearchType; // 0 = date; 1 = string; 2 = typo tolerant city
+    int sortDir = 1;
+    int state = 3; // 0 = exiting; 1 = normal viewing; 2 = filtered viewing, 3 = opening data, 4 = top results viewing
+    char fileName[50] = "../sample.csv"; // Starts with default directory
+    char exportName[50]; // Arrow file to export the view to
+    char journalName[sizeof(fileName) + sizeof(JOURNAL_EXTENSION)]; // Adds and deletes made since the file was saved
+    compare prevSort = dateTimeCompare; // Last used sort function
+    compare activeSort = NULL; // Sort function the list is currently in order of, NULL if still in file order
+    datePredicate prevDateSearch; // Last used date filter
+    stringPredicate prevStringSearch; // Last used string filter
+    char prevStringSearchString[MAX_SEARCH_STRING] = "hanover"; // Last used string filter text
+    date prevDateSearchDate = {2004, 12, 18}; // Last used date filter date
+
+    sightingNode *headNode = malloc(sizeof(sightingNode));
+    sightingNode unfinished; // Last row of the file when it had no newline, shown until following starts
+    sightingNode *node;
+    sightingNode **link;
+    viewIndex view = {NULL, 0, 0}; // Every row the user can page through: the whole list or the filter results
+    viewIndex searchResults = {NULL, 0, 0}; // Results of a new filter, before they replace the view
+    viewIndex swap;
+    char **mergeNames; // Files to merge when opening
+    cityIndex cities = {NULL, NULL, 0, NULL, 0, NULL, NULL, NULL};
+    filterCache filters; // Results of recent filters, so going back to one doesn't search again
+    FILE *journal;
+
+    if (argc > 1) // Commands on the command line run without the viewer
+        return runBatch(argc, argv);
+    filters.nodes = NULL;
+    filters.size = 0;
+    filters.nextId = 0;
+    filters.stale = 1;
+    filters.clock = 0;
+
+    printf(WELCOME);
+
+    // Opening file
+    menuInput = menu("Load data set (press return to use default)", openMenu, openMenuOptions,
+                     sizeof(openMenu) / sizeof(openMenu[0]), 2);
+    if (menuInput == 'e') {
+        getFileName(fileName); // Prompt the user for a file name
+    } else if (menuInput == 'm') {
+        printf("How many sorted files are there to merge? ");
+        getIntInput(&numFiles, 2);
+        if (numFiles < 1 || numFiles > MAX_MERGE_WAYS)
+            numFiles = numFiles < 1 ? 1 : MAX_MERGE_WAYS;
+        mergeNames = malloc(numFiles * sizeof(char *));
+        for (i = 0; i < numFiles; i++) {
+            mergeNames[i] = malloc(sizeof(fileName));
+            printf("File %d of %d: ", i + 1, numFiles);
+            getFileName(mergeNames[i]);
+        }
+        menuInput = menu("Which field are the files sorted by?", sortMenu, sortMenuOptions,
+                         sizeof(sortMenu) / sizeof(sortMenu[0]), 0);
+        prevSort = sortFunction(menuInput, prevSort, &sortDir);
+        printf("Enter the name of the file to merge into (this will overwrite existing files)\n> ");
+        scanf("%49s", fileName);
+        scanf("%c", &menuInput); // Clear the buffer
+        added = (int) mergeFiles(mergeNames, numFiles, fileName, sortDir, prevSort, &skipped);
+        for (i = 0; i < numFiles; i++)
+            free(mergeNames[i]);
+        free(mergeNames);
+        if (added < 0) {
+            free(headNode);
+            return 1;
+        }
+        // A journal left from a file that was there before holds changes to rows the merge replaced
+        snprintf(journalName, sizeof(journalName), "%s%s", fileName, JOURNAL_EXTENSION);
+        if (remove(journalName) == 0 || errno == ENOENT)
+            activeSort = prevSort; // The merged file is already in order, and nothing will be replayed over it
+        else
+            printf("Could not remove %s, so its changes will be replayed over the merged file\n", journalName);
+    } else {
+        printf("Using default file name %s\n", fileName);
+    }
+    // Following the file later reads from the offset, so a last row still being written is left out of it the same way,
+    // and only shown until following starts
+    size = loadData(fileName, headNode, &fileOffset, 1);
+    if (readLastRow(fileName, fileOffset, &unfinished)) {
+        node = size > 0 ? malloc(sizeof(sightingNode)) : headNode;
+        *node = unfinished;
+        if (size > 0)
+            insertSorted(&headNode, node, 1, NULL);
+        size++;
+        hasUnfinished = 1;
+    }
+    // Changes that were not compacted into the file yet are kept in the journal
+    strcpy(journalName, fileName);
+    strcat(journalName, JOURNAL_EXTENSION);
+    size += replayJournal(journalName, &headNode);
+    journal = fopen(journalName, "a");
+    if (journal == NULL)
+        printf("Could not open %s, so changes will only be kept by saving\n", journalName);
+    buildView(&view, headNode);
+    printPage(&view, viewingLocation);
+    state = 1;
+
+    while (state) {
+        menuInput = menu("Main Menu", mainMenu, mainMenuOptions, sizeof(mainMenu) / sizeof(mainMenu[0]), 0);
+        switch (menuInput) {
+            case 'v': // View (i.e. show the next ten elements)
+                if (viewingLocation + MAX_SEARCH_RESULTS >= view.size) { // Inform the user if they are at the end
+                    printf("You are already viewing the end of the data. Try 'c' to return to the top\n");
+                    break;
+                }
+                viewingLocation += MAX_SEARCH_RESULTS;
+                printPage(&view, viewingLocation);
+                break;
+            case 'b': // View previous (i.e. show the last ten elements)
+                if (viewingLocation == 0) {
+                    printf("You are already viewing the top of the data\n");
+                    break;
+                }
+                viewingLocation -= MAX_SEARCH_RESULTS;
+                if (viewingLocation < 0) // After jumping to a row, the previous page may be cut short
+                    viewingLocation = 0;
+                printPage(&view, viewingLocation);
+                break;
+            case 'o': // Sort option
+                menuInput = menu("Sorting Menu", sortMenu, sortMenuOptions,
+                                 sizeof(sortMenu) / sizeof(sortMenu[0]), 0);
+                prevSort = sortFunction(menuInput, prevSort, &sortDir);
+                // Sort and print
                 sortBy(&headNode, size, sortDir, prevSort);
-                viewingNode = headNode;
+                activeSort = prevSort;
+                filters.stale = 1;
+                buildView(&view, headNode);
                 viewingLocation = 0;
-                printList(viewingNode, MAX_SEARCH_RESULTS);
-                if (viewingLocation + 10 >= size) // If they are viewing the last 10 (or fewer) items, indicate that
-                    printf("End of data\n");
+                printPage(&view, viewingLocation);
                 state = 1;
                 break;
             case 'f': // Filter option
                 menuInput = menu("Filter (search) menu", filterMenu, filterMenuOptions,
-                                 sizeof(filterMenu) / sizeof(filterMenu[0]), 6);
+                                 sizeof(filterMenu) / sizeof(filterMenu[0]), 7);
                 switch (menuInput) { // Get proper user input and set predicate functions for each type of filter
                     case 'd':
                         getDateInput(&prevDateSearchDate, prevDateSearchDate);
-                        searchByDate(searchResults, headNode, dateOccurredPredicate, prevDateSearchDate);
+                        searchByDate(&searchResults, headNode, &filters, dateOccurredPredicate, prevDateSearchDate);
                         prevSearchType = 0;
                         prevDateSearch = dateOccurredPredicate;
-                        state = 2;
                         break;
                     case 't':
                         getStringInput(prevStringSearchString, "hanover");
-                        searchByString(searchResults, headNode, cityPredicate, prevStringSearchString);
+                        searchByString(&searchResults, headNode, &filters, cityPredicate, prevStringSearchString);
                         prevSearchType = 1;
                         prevStringSearch = cityPredicate;
-                        state = 2;
+                        break;
+                    case 'z':
+                        getStringInput(prevStringSearchString, "st. louis");
+                        if (citiesStale) { // Only build the index when the cities have changed since last time
+                            buildCityIndex(&cities, headNode, size);
+                            citiesStale = 0;
+                        }
+                        fuzzyCitySearch(&searchResults, headNode, &cities, prevStringSearchString);
+                        prevSearchType = 2;
                         break;
                     case 's':
                         getStringInput(prevStringSearchString, "nh");
-                        searchByString(searchResults, headNode, statePredicate, prevStringSearchString);
+                        searchByString(&searchResults, headNode, &filters, statePredicate, prevStringSearchString);
                         prevSearchType = 1;
                         prevStringSearch = statePredicate;
-                        state = 2;
                         break;
                     case 'c':
                         getStringInput(prevStringSearchString, "us");
-                        searchByString(searchResults, headNode, countryPredicate, prevStringSearchString);
+                        searchByString(&searchResults, headNode, &filters, countryPredicate, prevStringSearchString);
                         prevSearchType = 1;
                         prevStringSearch = countryPredicate;
-                        state = 2;
                         break;
                     case 'h':
                         getStringInput(prevStringSearchString, "circle");
-                        searchByString(searchResults, headNode, shapePredicate, prevStringSearchString);
+                        searchByString(&searchResults, headNode, &filters, shapePredicate, prevStringSearchString);
                         prevSearchType = 1;
                         prevStringSearch = shapePredicate;
-                        state = 2;
                         break;
                     case 'p':
                         getDateInput(&prevDateSearchDate, prevDateSearchDate);
-                        searchByDate(searchResults, headNode, dateReportedPredicate, prevDateSearchDate);
+                        searchByDate(&searchResults, headNode, &filters, dateReportedPredicate, prevDateSearchDate);
                         prevSearchType = 0;
                         prevDateSearch = dateReportedPredicate;
-                        state = 2;
-                        break;
-                    case 'r': // Clear filters--set state back to normal view
-                        state = 1;
                         break;
                 }
-                if (state == 2 && searchResults[0] != NULL) { // If there are results, show them
-                    viewingNode = headNode;
+                if (menuInput != 'r' && searchResults.size > 0) { // If there are results, show them
+                    swap = view; // The old view's memory is reused for the next search
+                    view = searchResults;
+                    searchResults = swap;
                     viewingLocation = 0;
-                    printArray(searchResults, MAX_SEARCH_RESULTS);
-                    if (containsNull(searchResults) || searchResults[9]->next == NULL)
-                        printf("End of data\n");
+                    state = 2;
                 } else {
-                    if (state == 2) // This shouldn't be printed if they just cleared the filter; they know
+                    if (menuInput != 'r') // This shouldn't be printed if they just cleared the filter; they know
                         printf("No results\n");
+                    if (state != 1) { // Leaving the filtered view, so go back to every row
+                        buildView(&view, headNode);
+                        viewingLocation = 0;
+                    }
+                    state = 1;
+                }
+                printPage(&view, viewingLocation);
+                break;
+            case 'c': // Back to top option
+                viewingLocation = 0;
+                printPage(&view, viewingLocation);
+                break;
+            case 'j': // Jump option
+                menuInput = menu("Jump menu", jumpMenu, jumpMenuOptions, sizeof(jumpMenu) / sizeof(jumpMenu[0]), 2);
+                if (menuInput == 'p') {
+                    getIntInput(&jump, 1);
+                    viewingLocation = (jump - 1) * MAX_SEARCH_RESULTS;
+                } else if (menuInput == 'w') {
+                    getIntInput(&jump, 1);
+                    viewingLocation = jump - 1;
+                } else { // e = the start of the last page
+                    viewingLocation = (view.size - 1) / MAX_SEARCH_RESULTS * MAX_SEARCH_RESULTS;
+                }
+                // Keep the location on an existing row
+                if (viewingLocation >= view.size)
+                    viewingLocation = (view.size - 1) / MAX_SEARCH_RESULTS * MAX_SEARCH_RESULTS;
+                if (viewingLocation < 0)
+                    viewingLocation = 0;
+                printPage(&view, viewingLocation);
+                break;
+            case 't': // Top results option
+                menuInput = menu("Top results by", sortMenu, sortMenuOptions,
+                                 sizeof(sortMenu) / sizeof(sortMenu[0]), 0);
+                prevSort = sortFunction(menuInput, prevSort, &sortDir);
+                getIntInput(&topCount, topCount);
+                if (topCount < 1)
+                    topCount = 1;
+                // Only the rows showing are considered, so a filter or earlier top results narrow it down
+                topK(&searchResults, &view, topCount, sortDir, prevSort);
+                swap = view;
+                view = searchResults;
+                searchResults = swap;
+                viewingLocation = 0;
+                state = 4;
+                printPage(&view, viewingLocation);
+                break;
+            case 'a': // Add entry option
+                state = 1;
+                addEntry(&headNode, journal);
+                citiesStale = 1;
+                filters.stale = 1;
+                buildView(&view, headNode);
+                viewingLocation = 0;
+                size++;
+                printPage(&view, viewingLocation);
+                break;
+            case 'r': // Remove entry option
+                if (removeEntry(&headNode, &view, viewingLocation, journal)) { // Only decrease size if removed
+                    size--;
+                    filters.stale = 1;
+                }
+                if (viewingLocation >= view.size) // The last row on the last page was removed
+                    viewingLocation -= MAX_SEARCH_RESULTS;
+                if (viewingLocation < 0)
+                    viewingLocation = 0;
+                printPage(&view, viewingLocation);
+                break;
+            case 'd': // Duplicates option
+                menuInput = menu("Duplicates menu", dedupMenu, dedupMenuOptions,
+                                 sizeof(dedupMenu) / sizeof(dedupMenu[0]), 0);
+                duplicates = dedupData(&headNode, menuInput == 'r', journal);
+                if (menuInput == 'r') {
+                    printf("Removed %d duplicates\n", duplicates);
+                    size -= duplicates;
+                    filters.stale = 1;
+                    buildView(&view, headNode);
+                    viewingLocation = 0;
+                    state = 1;
+                    printPage(&view, viewingLocation);
+                } else {
+                    printf("Found %d duplicates\n", duplicates);
+                }
+                break;
+            case 'g': // Clusters option
+                printf("Most kilometers between two sightings that are close\n");
+                getIntInput(&clusterDistanceKm, clusterDistanceKm);
+                printf("Most days between two sightings that are close\n");
+                getIntInput(&clusterDays, clusterDays);
+                printf("Fewest close sightings, counting itself, for a sighting to start a cluster\n");
+                getIntInput(&clusterMin, clusterMin);
+                if (clusterDistanceKm < 1)
+                    clusterDistanceKm = 1;
+                if (clusterDays < 1)
+                    clusterDays = 1;
+                if (clusterMin < 1)
+                    clusterMin = 1;
+                buildView(&searchResults, headNode);
+                labels = malloc((searchResults.size + 1) * sizeof(int));
+                numClusters = findClusters(&searchResults, clusterDistanceKm, clusterDays, clusterMin, labels);
+                if (numClusters == 0) {
+                    printf("No clusters\n");
+                    free(labels);
+                    break;
+                }
+                summaries = malloc(numClusters * sizeof(clusterSummary));
+                summarizeClusters(&searchResults, labels, numClusters, summaries);
+                printf("Found %d clusters\n", numClusters);
+                for (i = 0; i < numClusters && i < MAX_SEARCH_RESULTS; i++)
+                    printCluster(i + 1, &summaries[i]);
+                // Show the rows in clusters, largest cluster first
+                viewClusters(&view, &searchResults, labels, numClusters);
+                free(labels);
+                free(summaries);
+                viewingLocation = 0;
+                state = 4;
+                printPage(&view, viewingLocation);
+                break;
+            case 'x': // Export option
+                printf("Enter the name of the file to export to (this will overwrite existing files)\n> ");
+                scanf("%49s", exportName);
+                scanf("%c", &menuInput); // Clear the buffer
+                if (exportArrow(exportName, &view))
+                    printf("Exported %d sightings to %s\n", view.size, exportName);
+                else
+                    printf("Could not write to %s\n", exportName);
+                break;
+            case 's': // Save option
+                if (saveData(headNode, fileName, &journal, &fileOffset))
+                    state = 0;
+                break;
+            case 'l': // Follow option
+                if (hasUnfinished) { // Following reads the last row again once it has a newline, so take it out
+                    for (link = &headNode; *link != NULL && !nodeEquals(*link, &unfinished); link = &(*link)->next);
+                    if (*link != NULL) {
+                        node = *link;
+                        *link = node->next;
+                        free(node);
+                        size--;
+                        citiesStale = 1;
+                        filters.stale = 1;
+                    }
+                    hasUnfinished = 0;
+                }
+                added = followData(fileName, &headNode, &fileOffset, sortDir, activeSort);
+                size += added;
+                printf("%d new sightings added\n", added);
+                if (added > 0) {
+                    citiesStale = 1;
+                    filters.stale = 1;
+                }
+                if (state == 2) { // New rows may match the filter, so search again from the top
+                    if (prevSearchType == 2) {
+                        buildCityIndex(&cities, headNode, size);
+                        citiesStale = 0;
+                        fuzzyCitySearch(&view, headNode, &cities, prevStringSearchString);
+                    } else if (prevSearchType)
+                        searchByString(&view, headNode, &filters, prevStringSearch, prevStringSearchString);
+                    else
+                        searchByDate(&view, headNode, &filters, prevDateSearch, prevDateSearchDate);
+                } else { // Top results may be out of date, so go back to every row
+                    buildView(&view, headNode);
                     state = 1;
-                    printList(viewingNode, MAX_SEARCH_RESULTS);
-                    if (viewingLocation + 10 >= size) // If they are viewing the last 10 (or fewer) items, indicate that
-                        printf("End of data\n");
                 }
+                viewingLocation = 0;
+                printPage(&view, viewingLocation);
+                break;
+            case 'k': // Compact option
+                if (compactData(fileName, headNode, &journal, &fileOffset))
+                    hasUnfinished = 0; // The file was written again, so every row in it is finished
+                break;
+            case 'q': // Quit option
+                printf("Exiting program...");
+                state = 0;
+                break;
+        }
+    }
+
+    if (journal != NULL)
+        fclose(journal);
+    freeView(&view);
+    freeView(&searchResults);
+    freeCityIndex(&cities);
+    for (i = 0; i < filters.size; i++)
+        free(filters.entries[i].bits);
+    free(filters.nodes);
+    freeData(headNode);
+    return 0;
+}
+
+void addEntry(sightingNode **head, FILE *journal) {
+    sightingNode *node = malloc(sizeof(sightingNode));
+    char out[500];
+    char c;
+    int i;
+
+    *out = '\0';
+    do {
+        c = ' ';
+        i = 1;
+        if (*out != '\0')
+            printf("Invalid entry\n");
+        printf("Enter a new record in the CSV form \"12/18/2004 14:30,Hanover,NH,US,circle,120,I TOTALLY SAW A CRAZY CIRCLE ORB,5/7/2024,43.703514,-72.294490\"\n> ");
+        scanf("%c", out);
+        c = out[0];
+        while (c != '\n') {
+            scanf("%c", &c);
+            if (c != '\n')
+                out[i] = c;
+            else
+                out[i] = '\0';
+            i++;
+        }
+    } while (!parseNode(out, node));
+
+    node->next = *head;
+    *head = node;
+    journalEntry(journal, '+', node);
+}
+
+void buildCityIndex(cityIndex *index, sightingNode *head, int size) {
+    sightingNode *node = head;
+    int i;
+
+    freeCityIndex(index);
+    index->tableSize = 1;
+    while (index->tableSize < size * 2) // There can't be more distinct cities than rows
+        index->tableSize *= 2;
+    index->table = malloc(index->tableSize * sizeof(int));
+    for (i = 0; i < index->tableSize; i++)
+        index->table[i] = -1;
+    index->names = malloc(size * sizeof(*index->names));
+    index->normalized = malloc(size * sizeof(*index->normalized));
+    index->postings = calloc(TRIGRAMS, sizeof(int *));
+    index->postingSizes = calloc(TRIGRAMS, sizeof(int));
+    index->postingCapacities = calloc(TRIGRAMS, sizeof(int));
+    while (node != NULL) {
+        cityId(index, node->city, 1);
+        node = node->next;
+    }
+}
+
+void buildView(viewIndex *view, sightingNode *head) {
+    sightingNode *node = head;
+    view->size = 0;
+    while (node != NULL) {
+        viewAppend(view, node);
+        node = node->next;
+    }
+}
+
+unsigned long long dedupKey(sightingNode *node) {
+    unsigned long long hash = FNV_OFFSET;
+    char time[20];
+    snprintf(time, sizeof(time), "%d/%d/%d %d:%d", node->dateTime.date.month, node->dateTime.date.day,
+             node->dateTime.date.year, node->dateTime.hour, node->dateTime.minute);
+    // Spacers between fields keep "ab" + "c" from hashing the same as "a" + "bc"
+    hash = hashString(hash, time);
+    hash = hashString(hash, ",");
+    hash = hashString(hash, node->city);
+    hash = hashString(hash, ",");
+    hash = hashString(hash, node->state);
+    hash = hashString(hash, ",");
+    return hashString(hash, node->shape);
+}
+
+void freeData(sightingNode *head) {
+    if (head->next == NULL)
+        free(head); // If this is the last node, free it
+    else
+        freeData(head->next); // Recursively free the subsequent nodes
+}
+
+int followData(char fileName[], sightingNode **head, long *offset, int dir, compare function) {
+    FILE *csv;
+    sightingNode *node = malloc(sizeof(sightingNode));
+    fd_set input;
+    struct timeval timeout;
+    int added = 0;
+    int result;
+    char _;
+
+    printf("Following %s for new sightings. Press return to stop\n", fileName);
+    while (1) {
+        csv = fopen(fileName, "r");
+        if (csv != NULL) {
+            fseek(csv, 0, SEEK_END);
+            if (ftell(csv) < *offset) { // The file got shorter, so it was replaced; start again from the top of it
+                printf("%s was truncated; following from the start\n", fileName);
+                *offset = 0;
+            }
+            fseek(csv, *offset, SEEK_SET);
+            // Only read the rows past the offset, and stop before a row that has not been fully written yet
+            while ((result = readNode(csv, node, 1, NULL)) != 0) {
+                if (result < 0) {
+                    printf("Skipping a row that could not be read\n");
+                    continue;
+                }
+                printf("+ ");
+                printNode(node);
+                printf("\n");
+                insertSorted(head, node, dir, function);
+                node = malloc(sizeof(sightingNode));
+                added++;
+            }
+            *offset = ftell(csv);
+            fclose(csv);
+        }
+
+        // Wait for the next poll, stopping early if the user presses return
+        FD_ZERO(&input);
+        FD_SET(STDIN_FILENO, &input);
+        timeout.tv_sec = FOLLOW_POLL_SECONDS;
+        timeout.tv_usec = 0;
+        if (select(STDIN_FILENO + 1, &input, NULL, NULL, &timeout) > 0) {
+            do { // Clear the buffer
+                if (scanf("%c", &_) != 1)
+                    break;
+            } while (_ != '\n');
+            break;
+        }
+    }
+
+    free(node);
+    return added;
+}
+
+void freeCityIndex(cityIndex *index) {
+    int i;
+    if (index->postings != NULL)
+        for (i = 0; i < TRIGRAMS; i++)
+            free(index->postings[i]);
+    free(index->postings);
+    free(index->postingSizes);
+    free(index->postingCapacities);
+    free(index->names);
+    free(index->normalized);
+    free(index->table);
+    index->postings = NULL;
+    index->postingSizes = NULL;
+    index->postingCapacities = NULL;
+    index->names = NULL;
+    index->normalized = NULL;
+    index->table = NULL;
+    index->size = 0;
+}
+
+void freeView(viewIndex *view) {
+    free(view->rows);
+    view->rows = NULL;
+    view->size = 0;
+    view->capacity = 0;
+}
+
+void getDateInput(date *output, date defaultDate) {
+    char out[50];
+    char c;
+    int i;
+    *out = '\0';
+    do {
+        c = ' ';
+        i = 1;
+        if (*out != '\0') // Only on the first iteration
+            printf("Invalid date\n");
+        printf("Enter search date in the form YYYY-MM-DD\n> ");
+        scanf("%c", out);
+        if (out[0] == '\n') { // If the user returns with nothing
+            printf("Using default date");
+            *output = defaultDate;
+            return;
+        }
+        while (c != '\n') { // Continue reading character by character up to the newline
+            scanf("%c", &c);
+            if (c != '\n')
+                out[i] = c;
+            else
+                out[i] = '\0';
+            i++;
+        }
+        printf("\nSTRING: %s\n", out);
+        // Try to parse the string. If it cannot be parsed, the data was invalid, so repeat and tell the user that.
+    } while (sscanf(out, "%d-%d-%d", &output->year, &output->month, &output->day) != 3);
+}
+
+void getFileName(char fileName[]) {
+    int incomplete = 1;
+    FILE *file;
+    char _;
+    while (incomplete) {
+        printf("Enter file name\n> ");
+        scanf("%s", fileName);
+        file = fopen(fileName, "r");
+        if (file != NULL) { // If the file exists, nothing else to do in this function
+            incomplete = 0;
+            fclose(file);
+            scanf("%c", &_); // Clear the buffer
+        } else { // If not, tell the user that
+            printf("That file does not exist\n");
+        }
+    }
+}
+
+void fuzzyCitySearch(viewIndex *results, sightingNode *head, cityIndex *index, char city[]) {
+    char query[MAX_CITY];
+    int length = normalizeCity(city, query);
+    int *shared = calloc(index->size + 1, sizeof(int)); // Trigrams each city shares with the query
+    int *distances = malloc((index->size + 1) * sizeof(int));
+    int *candidates = malloc((index->size + 1) * sizeof(int));
+    int *seen = calloc(TRIGRAMS, sizeof(int));
+    int numCandidates = 0, repeats = 0;
+    int letters = length - 2; // Without the spaces normalizeCity puts around the name
+    int maxDistance = letters <= FUZZY_SHORT_LETTERS ? 1 : 2;
+    int minShared, cityLength, i, j, t, id, best;
+    sightingNode *node = head;
+
+    // Every trigram of the query that is in the index leads to the cities containing it
+    for (i = 0; i + 3 <= length; i++) {
+        t = trigram(query + i);
+        if (seen[t]++) { // Count repeated trigrams once
+            repeats++;
+            continue;
+        }
+        for (j = 0; j < index->postingSizes[t]; j++)
+            if (shared[index->postings[t][j]]++ == 0)
+                candidates[numCandidates++] = index->postings[t][j];
+    }
+    // Only the candidates that share enough trigrams are compared character by character
+    for (i = 0, j = 0; i < numCandidates; i++) {
+        id = candidates[i];
+        cityLength = (int) strlen(index->normalized[id]);
+        // Each edit changes at most three of the trigrams of the longer name, and the query's repeated trigrams were
+        // only counted once
+        minShared = (cityLength > length ? cityLength : length) - 2 - 3 * maxDistance - repeats;
+        if (minShared < 1)
+            minShared = 1;
+        if (abs(cityLength - length) <= maxDistance && shared[id] >= minShared &&
+            (distances[id] = editDistance(query, index->normalized[id])) <= maxDistance)
+            candidates[j++] = id;
+        shared[id] = 0;
+    }
+    numCandidates = j;
+    printf("%d cities within %d edits of \"%s\" (out of %d cities)\n", numCandidates, maxDistance, city,
+           index->size);
+
+    // Show the closest few, sorting in place by selection since there are only a few to show
+    for (i = 0; i < numCandidates && i < MAX_FUZZY_SUGGESTIONS; i++) {
+        best = i;
+        for (j = i + 1; j < numCandidates; j++)
+            if (distances[candidates[j]] < distances[candidates[best]])
+                best = j;
+        id = candidates[best];
+        candidates[best] = candidates[i];
+        candidates[i] = id;
+        printf("  %s (%d edits)\n", index->names[id], distances[id]);
+    }
+
+    // Keep every row that is in one of the matching cities
+    for (i = 0; i < numCandidates; i++)
+        shared[candidates[i]] = 1;
+    results->size = 0;
+    while (node != NULL) {
+        id = cityId(index, node->city, 0);
+        if (id != -1 && shared[id])
+            viewAppend(results, node);
+        node = node->next;
+    }
+
+    free(shared);
+    free(distances);
+    free(candidates);
+    free(seen);
+}
+
+void getIntInput(int *output, int defaultInt) {
+    char out[50];
+    char c;
+    int i;
+    *out = '\0';
+    do {
+        c = ' ';
+        i = 1;
+        if (*out != '\0') // Only on the first iteration
+            printf("Invalid number\n");
+        printf("Enter a number\n> ");
+        scanf("%c", out);
+        if (out[0] == '\n') { // If the user returns with nothing
+            printf("Using default number %d\n", defaultInt);
+            *output = defaultInt;
+            return;
+        }
+        while (c != '\n') { // Continue reading character by character up to the newline
+            scanf("%c", &c);
+            if (c != '\n' && i < (int) sizeof(out) - 1)
+                out[i] = c;
+            else
+                out[i] = '\0';
+            i++;
+        }
+        // Try to parse the string. If it cannot be parsed, the data was invalid, so repeat and tell the user that.
+    } while (sscanf(out, "%d", output) != 1);
+}
+
+void getStringInput(char output[], char defaultString[]) {
+    char out[50];
+    char c = ' ';
+    int i = 1;
+    printf("Enter search term\n> ");
+    scanf("%c", out);
+    if (out[0] == '\n') {
+        printf("Using default term %s\n", defaultString);
+        strcpy(output, defaultString);
+        return;
+    }
+    while (c != '\n') { // Read character by character until the whole string is read
+        scanf("%c", &c);
+        if (c != '\n')
+            out[i] = c;
+        else
+            out[i] = '\0';
+        i++;
+    }
+    strcpy(output, out);
+}
+
+void insertSorted(sightingNode **head, sightingNode *node, int dir, compare function) {
+    sightingNode **cur = head;
+    // Move past every node that should come before the new one
+    while (*cur != NULL && function != NULL && function(*cur, node, dir) <= 0)
+        cur = &(*cur)->next;
+    while (*cur != NULL && function == NULL) // Without a sort order, keep file order by appending
+        cur = &(*cur)->next;
+    node->next = *cur;
+    *cur = node;
+}
+
+void journalEntry(FILE *journal, char op, sightingNode *node) {
+    if (journal == NULL) // The journal could not be opened, so changes are only kept by saving
+        return;
+    fprintf(journal, "%c", op);
+    saveNode(journal, node);
+    fprintf(journal, "\n");
+    // Push the entry all the way to the disk so the change survives a crash
+    fflush(journal);
+    fsync(fileno(journal));
+}
+
+void mergeSiftDown(int heap[], int size, int i, sightingNode heads[], int dir, compare function) {
+    int child, tmp, result;
+    while ((child = 2 * i + 1) < size) {
+        // Pick whichever child sorts first; ties go to the earlier run
+        if (child + 1 < size) {
+            result = function(&heads[heap[child + 1]], &heads[heap[child]], dir);
+            if (result < 0 || (result == 0 && heap[child + 1] < heap[child]))
+                child++;
+        }
+        result = function(&heads[heap[child]], &heads[heap[i]], dir);
+        if (result > 0 || (result == 0 && heap[child] > heap[i]))
+            break;
+        tmp = heap[child];
+        heap[child] = heap[i];
+        heap[i] = tmp;
+        i = child;
+    }
+}
+
+void mergeSort(sightingNode **rows, sightingNode **buffer, int size, int dir, compare function) {
+    int half = size / 2;
+    int i = 0, j = half, k = 0;
+    if (size < 2)
+        return;
+    mergeSort(rows, buffer, half, dir, function);
+    mergeSort(rows + half, buffer, size - half, dir, function);
+    // Take from the left half on ties so equal rows keep their order
+    while (i < half && j < size)
+        buffer[k++] = function(rows[j], rows[i], dir) < 0 ? rows[j++] : rows[i++];
+    while (i < half)
+        buffer[k++] = rows[i++];
+    while (j < size)
+        buffer[k++] = rows[j++];
+    memcpy(rows, buffer, size * sizeof(sightingNode *));
+}
+
+long mergeRuns(FILE *runs[], csvPosition positions[], int numRuns, FILE *output, int dir, compare function) {
+    sightingNode *heads = malloc(numRuns * sizeof(sightingNode)); // The next row of each run
+    int *heap = malloc(numRuns * sizeof(int));
+    int size = 0, i, result;
+    long written = 0;
+    long outOfOrder = 0; // Rows that sort before the row written before them from the same run
+    sightingNode previous;
+
+    // Start with the first row of every run
+    for (i = 0; i < numRuns; i++) {
+        // Skip rows that could not be read, which are reported by readNode
+        while ((result = readNode(runs[i], &heads[i], 0, positions != NULL ? &positions[i] : NULL)) < 0);
+        if (result == 1)
+            heap[size++] = i;
+    }
+    for (i = size / 2 - 1; i >= 0; i--) // Heapify by sifting down each parent, starting from the last
+        mergeSiftDown(heap, size, i, heads, dir, function);
+
+    while (size > 0) {
+        // The root is the first row out of all the runs; replace it with the next row of its run
+        saveNode(output, &heads[heap[0]]);
+        fprintf(output, "\n");
+        written++;
+        previous = heads[heap[0]];
+        while ((result = readNode(runs[heap[0]], &heads[heap[0]], 0,
+                                  positions != NULL ? &positions[heap[0]] : NULL)) < 0);
+        if (result == 0) // That run is done
+            heap[0] = heap[--size];
+        else if (function(&previous, &heads[heap[0]], dir) > 0)
+            outOfOrder++;
+        mergeSiftDown(heap, size, 0, heads, dir, function);
+    }
+
+    if (outOfOrder > 0)
+        printf("Warning: %ld rows were not in sorted order in their file, so the output is not fully sorted\n",
+               outOfOrder);
+    free(heads);
+    free(heap);
+    return written;
+}
+
+long mergeFiles(char *inNames[], int numFiles, char outName[], int dir, compare function, int *skipped) {
+    FILE **files = malloc(numFiles * sizeof(FILE *));
+    csvPosition *positions = malloc(numFiles * sizeof(csvPosition));
+    FILE *output;
+    long written = -1;
+    int opened, i;
+
+    *skipped = 0;
+    for (opened = 0; opened < numFiles; opened++) {
+        files[opened] = fopen(inNames[opened], "r");
+        if (files[opened] == NULL) {
+            printf("There is no file called %s\n", inNames[opened]);
+            break;
+        }
+        // Opening the output would empty a file that is still to be read
+        if (sameFile(inNames[opened], outName)) {
+            printf("%s is one of the files to merge, so it can't be the output\n", outName);
+            fclose(files[opened]);
+            break;
+        }
+        positions[opened] = (csvPosition) {inNames[opened], 1, 0};
+    }
+    if (opened == numFiles) {
+        output = fopen(outName, "w");
+        if (output == NULL) {
+            printf("Could not write to %s\n", outName);
+        } else {
+            written = mergeRuns(files, positions, numFiles, output, dir, function);
+            fclose(output);
+            printf("Merged %ld sightings from %d files into %s\n", written, numFiles, outName);
+            for (i = 0; i < numFiles; i++) {
+                if (positions[i].errors > 0)
+                    printf("Left out %d rows of %s that could not be read\n", positions[i].errors, inNames[i]);
+                *skipped += positions[i].errors;
+            }
+        }
+    }
+
+    for (i = 0; i < opened; i++)
+        fclose(files[i]);
+    free(files);
+    free(positions);
+    return written;
+}
+
+void bufferAppend(byteBuffer *buffer, const void *bytes, long size) {
+    if (buffer->size + size > buffer->capacity) {
+        buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        if (buffer->capacity < buffer->size + size)
+            buffer->capacity = buffer->size + size;
+        buffer->bytes = realloc(buffer->bytes, buffer->capacity);
+    }
+    memcpy(buffer->bytes + buffer->size, bytes, size);
+    buffer->size += size;
+}
+
+void flushCommentBlock(byteBuffer *comments, byteBuffer *block) {
+    byteBuffer compressed = {NULL, 0, 0};
+    lzCompress(&compressed, block->bytes, (int) block->size);
+    putVarint(comments, block->size);
+    putBuffer(comments, &compressed);
+    free(compressed.bytes);
+    block->size = 0;
+}
+
+void freeColumns(columnStore *store) {
+    freeDictionary(&store->cities);
+    freeDictionary(&store->states);
+    freeDictionary(&store->countries);
+    freeDictionary(&store->shapes);
+    free(store->occurred.bytes);
+    free(store->reported.bytes);
+    free(store->durations.bytes);
+    free(store->coordinates.bytes);
+    free(store->comments.bytes);
+    memset(store, 0, sizeof(columnStore));
+}
+
+void lzCompress(byteBuffer *output, unsigned char input[], int size) {
+    int table[1 << LZ_HASH_BITS]; // Last position each hash of LZ_MIN_MATCH bytes was seen at
+    int i = 0, literals = 0, length, candidate;
+    unsigned int h;
+
+    for (i = 0; i < 1 << LZ_HASH_BITS; i++)
+        table[i] = -1;
+    i = 0;
+    while (i + LZ_MIN_MATCH <= size) {
+        h = ((unsigned int) input[i] | (unsigned int) input[i + 1] << 8 | (unsigned int) input[i + 2] << 16 |
+             (unsigned int) input[i + 3] << 24) * 2654435761u >> (32 - LZ_HASH_BITS);
+        candidate = table[h];
+        table[h] = i;
+        if (candidate >= 0 && memcmp(input + candidate, input + i, LZ_MIN_MATCH) == 0) {
+            length = LZ_MIN_MATCH;
+            while (i + length < size && input[candidate + length] == input[i + length])
+                length++;
+            putVarint(output, literals);
+            bufferAppend(output, input + i - literals, literals);
+            putVarint(output, length);
+            putVarint(output, i - candidate);
+            i += length;
+            literals = 0;
+        } else {
+            i++;
+            literals++;
+        }
+    }
+    literals += size - i;
+    putVarint(output, literals);
+    bufferAppend(output, input + size - literals, literals);
+}
+
+
+void openCursor(columnCursor *cursor, columnStore *store, char wanted[]) {
+    cursor->row = 0;
+    cursor->occurred = store->occurred.bytes;
+    cursor->reported = store->reported.bytes;
+    cursor->durations = store->durations.bytes;
+    cursor->coordinates = store->coordinates.bytes;
+    cursor->comments = store->comments.bytes;
+    cursor->prevOccurred = 0;
+    cursor->prevReported = 0;
+    cursor->block = malloc(COMMENT_BLOCK_ROWS * MAX_COMMENT + 1);
+    cursor->comment = NULL;
+    cursor->blockRows = 0;
+    cursor->wanted = wanted;
+}
+
+void packIds(dictionaryColumn *column, int ids[], int size) {
+    long bit;
+    int i, j;
+
+    column->bits = 0;
+    while (1 << column->bits < column->size)
+        column->bits++;
+    column->ids.size = ((long) size * column->bits + 7) / 8;
+    column->ids.capacity = column->ids.size + 8; // unpackId reads 8 bytes at a time
+    column->ids.bytes = calloc(column->ids.capacity, 1);
+    for (i = 0; i < size; i++) {
+        bit = (long) i * column->bits;
+        for (j = 0; j < column->bits; j++, bit++)
+            if (ids[i] >> j & 1)
+                column->ids.bytes[bit / 8] |= (unsigned char) (1 << bit % 8);
+    }
+}
+
+void putBuffer(byteBuffer *output, byteBuffer *section) {
+    putVarint(output, section->size);
+    bufferAppend(output, section->bytes, section->size);
+}
+
+void putVarint(byteBuffer *buffer, long long value) {
+    unsigned long long zigzag = (unsigned long long) value << 1 ^ (unsigned long long) (value >> 63);
+    unsigned char bytes[10];
+    int size = 0;
+    do {
+        bytes[size] = (unsigned char) (zigzag & 0x7f);
+        zigzag >>= 7;
+        if (zigzag)
+            bytes[size] |= 0x80;
+        size++;
+    } while (zigzag);
+    bufferAppend(buffer, bytes, size);
+}
+
+
+void startDictionary(dictionaryColumn *column, int rows) {
+    int i;
+    column->tableSize = 1;
+    while (column->tableSize < rows * 2) // There can't be more distinct values than rows
+        column->tableSize *= 2;
+    column->table = malloc(column->tableSize * sizeof(int));
+    for (i = 0; i < column->tableSize; i++)
+        column->table[i] = -1;
+}
+
+void answerQuery(queryServer *server, char request[], FILE *output) {
+    char command[16] = "";
+    char field[3] = "";
+    char *argument = request;
+    char *value;
+    sightingNode *node, *prev, removed;
+    stringPredicate stringSearch = NULL;
+    datePredicate dateSearch = NULL;
+    viewIndex results = {NULL, 0, 0};
+    dictionaryColumn groups;
+    compare function;
+    date d;
+    int count = 0, dir, rows = MAX_SEARCH_RESULTS, i;
+    int *counts;
+    int (*pairs)[2];
+
+    // Split the request into the command, a field letter, and the rest
+    sscanf(request, "%15s", command);
+    while (*argument != '\0' && *argument != ' ')
+        argument++;
+    while (*argument == ' ')
+        argument++;
+    value = argument[0] != '\0' && argument[1] == ' ' ? argument + 2 : argument + strlen(argument);
+
+    if (strcmp(command, "filter") == 0) {
+        switch (argument[0]) {
+            case 'd':
+                dateSearch = dateOccurredPredicate;
                 break;
-            case 'c': // Back to top option
-                if (state == 2) { // Check for filtered view; then move array by searching from head node
-                    if (prevSearchType)
-                        searchByString(searchResults, headNode, prevStringSearch, prevStringSearchString);
-                    else
-                        searchByDate(searchResults, headNode, prevDateSearch, prevDateSearchDate);
-                    printArray(searchResults, MAX_SEARCH_RESULTS);
-                    if (containsNull(searchResults) || searchResults[9]->next == NULL)
-                        printf("End of data\n");
-                } else { // In normal view, set viewing tracker to 0 and print again
-                    viewingNode = headNode;
-                    viewingLocation = 0;
-                    printList(viewingNode, MAX_SEARCH_RESULTS);
-                    if (viewingLocation + 10 >= size) // If they are viewing the last 10 (or fewer) items, indicate that
-                        printf("End of data\n");
+            case 'p':
+                dateSearch = dateReportedPredicate;
+                break;
+            case 't':
+                stringSearch = cityPredicate;
+                break;
+            case 's':
+                stringSearch = statePredicate;
+                break;
+            case 'c':
+                stringSearch = countryPredicate;
+                break;
+            case 'h':
+                stringSearch = shapePredicate;
+                break;
+        }
+        if ((stringSearch == NULL && dateSearch == NULL) ||
+            (dateSearch != NULL && sscanf(value, "%d/%d/%d", &d.month, &d.day, &d.year) != 3)) {
+            fprintf(output, "ERROR usage: filter d|t|s|c|h|p value\n");
+            return;
+        }
+        pthread_rwlock_rdlock(&server->lock);
+        for (node = server->head; node != NULL; node = node->next) {
+            if (stringSearch != NULL ? stringSearch(node, value) : dateSearch(node, d)) {
+                if (count++ < MAX_SEARCH_RESULTS) { // Only the first page of rows is sent, with the total
+                    saveNode(output, node);
+                    fprintf(output, "\n");
+                }
+            }
+        }
+        pthread_rwlock_unlock(&server->lock);
+        fprintf(output, "END %d\n", count);
+    } else if (strcmp(command, "sort") == 0) {
+        if (sscanf(argument, "%2s %d", field, &rows) < 1 || (function = parseSortField(field, &dir)) == NULL ||
+            rows < 1) {
+            fprintf(output, "ERROR usage: sort d|t|s|c|h|u|p [rows], capital to reverse\n");
+            return;
+        }
+        // The shared list is never reordered, so the first rows in order come from a bounded heap
+        pthread_rwlock_rdlock(&server->lock);
+        topK(&results, &server->view, rows, dir, function);
+        for (i = 0; i < results.size; i++) {
+            saveNode(output, results.rows[i]);
+            fprintf(output, "\n");
+        }
+        pthread_rwlock_unlock(&server->lock);
+        fprintf(output, "END %d\n", results.size);
+        freeView(&results);
+    } else if (strcmp(command, "count") == 0) {
+        if (!contains(argument[0], "tsch", 4) || argument[1] != '\0') {
+            fprintf(output, "ERROR usage: count t|s|c|h\n");
+            return;
+        }
+        // Count the rows with each value, using a dictionary to give each value an id
+        memset(&groups, 0, sizeof(groups));
+        pthread_rwlock_rdlock(&server->lock);
+        startDictionary(&groups, server->size);
+        counts = calloc(server->size + 1, sizeof(int));
+        for (node = server->head; node != NULL; node = node->next)
+            counts[dictionaryId(&groups, argument[0] == 't' ? node->city : argument[0] == 's' ? node->state :
+                                         argument[0] == 'c' ? node->country : node->shape)]++;
+        pthread_rwlock_unlock(&server->lock);
+        pairs = malloc((groups.size + 1) * sizeof(*pairs));
+        for (i = 0; i < groups.size; i++) {
+            pairs[i][0] = counts[i];
+            pairs[i][1] = i;
+        }
+        qsort(pairs, groups.size, sizeof(*pairs), countCompare);
+        for (i = 0; i < groups.size; i++)
+            fprintf(output, "%s,%d\n", groups.values[pairs[i][1]], pairs[i][0]);
+        fprintf(output, "END %d\n", groups.size);
+        free(pairs);
+        free(counts);
+        freeDictionary(&groups);
+    } else if (strcmp(command, "add") == 0) {
+        node = malloc(sizeof(sightingNode));
+        if (!parseNode(argument, node)) {
+            free(node);
+            fprintf(output, "ERROR could not read the row\n");
+            return;
+        }
+        // Sync the journal before taking the lock, so queries never wait on the disk
+        pthread_mutex_lock(&server->writeLock);
+        journalEntry(server->journal, '+', node);
+        pthread_rwlock_wrlock(&server->lock);
+        node->next = server->head;
+        server->head = node;
+        server->size++;
+        viewAppend(&server->view, node); // Makes room, then every row moves down one for the new first row
+        memmove(server->view.rows + 1, server->view.rows, (server->view.size - 1) * sizeof(sightingNode *));
+        server->view.rows[0] = node;
+        pthread_rwlock_unlock(&server->lock);
+        pthread_mutex_unlock(&server->writeLock);
+        fprintf(output, "END 1\n");
+    } else if (strcmp(command, "remove") == 0) {
+        if (!parseNode(argument, &removed)) {
+            fprintf(output, "ERROR could not read the row\n");
+            return;
+        }
+        // Only writers change the list, so while holding writeLock it can be searched without blocking queries
+        pthread_mutex_lock(&server->writeLock);
+        for (i = 0, prev = NULL, node = server->head; node != NULL && !nodeEquals(node, &removed); node = node->next) {
+            prev = node;
+            i++;
+        }
+        if (node != NULL) {
+            journalEntry(server->journal, '-', node);
+            pthread_rwlock_wrlock(&server->lock);
+            if (prev == NULL)
+                server->head = node->next;
+            else
+                prev->next = node->next;
+            server->size--;
+            // The view is in list order, so the row is at the same index
+            memmove(server->view.rows + i, server->view.rows + i + 1,
+                    (server->view.size - i - 1) * sizeof(sightingNode *));
+            server->view.size--;
+            pthread_rwlock_unlock(&server->lock);
+            free(node);
+            count = 1;
+        }
+        pthread_mutex_unlock(&server->writeLock);
+        fprintf(output, "END %d\n", count);
+    } else if (strcmp(command, "size") == 0) {
+        pthread_rwlock_rdlock(&server->lock);
+        count = server->size;
+        pthread_rwlock_unlock(&server->lock);
+        fprintf(output, "END %d\n", count);
+    } else {
+        fprintf(output, "ERROR commands are filter, sort, count, add, remove, and size\n");
+    }
+}
+
+void *benchThread(void *worker) {
+    benchWorker *w = worker;
+    char *queries[] = {"filter s ca\n", "filter s tx\n", "filter h circle\n", "filter t seattle\n",
+                       "filter d 7/4/2010\n", "sort u 10\n", "sort D 10\n", "count h\n", "count s\n"};
+    int numQueries = sizeof(queries) / sizeof(queries[0]);
+    int socket = connectServer(w->socketName);
+    FILE *input, *output;
+    double start;
+    int i;
+
+    w->failed = 0;
+    if (socket < 0) {
+        w->failed = w->queries;
+        memset(w->latencies, 0, w->queries * sizeof(double));
+        return NULL;
+    }
+    input = fdopen(socket, "r");
+    output = fdopen(dup(socket), "w");
+    for (i = 0; i < w->queries; i++) {
+        start = secondsNow();
+        if (!queryServerOnce(queries[rand_r(&w->seed) % numQueries], input, output, NULL))
+            w->failed++;
+        w->latencies[i] = secondsNow() - start;
+    }
+    fclose(output);
+    fclose(input);
+    return NULL;
+}
+
+void freeDictionary(dictionaryColumn *column) {
+    int i;
+    for (i = 0; i < column->size; i++)
+        free(column->values[i]);
+    free(column->values);
+    free(column->table);
+    free(column->ids.bytes);
+}
+
+void *serveConnection(void *connection) {
+    serverConnection *c = connection;
+    FILE *input = fdopen(c->socket, "r");
+    FILE *output = fdopen(dup(c->socket), "w");
+    FILE *answer;
+    char *request = NULL;
+    char *text;
+    size_t length;
+    int capacity = 0;
+    int size;
+    int open;
+    int i;
+
+    // A row given to add or remove may be longer than a line, or go over several when a quoted field has line breaks
+    while ((size = readRecord(input, &request, &capacity, &open)) > 0) {
+        while (size > 0 && (request[size - 1] == '\n' || request[size - 1] == '\r'))
+            request[--size] = '\0';
+        // The answer is built in memory first, so the lock is never held while waiting on a slow client
+        answer = open_memstream(&text, &length);
+        answerQuery(c->server, request, answer);
+        fclose(answer);
+        fwrite(text, 1, length, output);
+        fflush(output);
+        free(text);
+    }
+
+    pthread_mutex_lock(&c->server->connectionsLock);
+    for (i = 0; c->server->sockets[i] != c->socket; i++);
+    c->server->sockets[i] = c->server->sockets[--c->server->numSockets];
+    pthread_cond_signal(&c->server->connectionsDone);
+    pthread_mutex_unlock(&c->server->connectionsLock);
+    free(request);
+    fclose(output);
+    fclose(input);
+    free(c);
+    return NULL;
+}
+
+void clusterUnion(atomic_int parent[], int a, int b) {
+    int expected;
+    while (1) {
+        a = clusterRoot(parent, a);
+        b = clusterRoot(parent, b);
+        if (a == b)
+            return;
+        if (a < b) { // Always link the larger root under the smaller, so links can't form a loop
+            expected = a;
+            a = b;
+            b = expected;
+        }
+        expected = a;
+        // Only succeeds if a is still a root; otherwise another thread linked it first, so try again
+        if (atomic_compare_exchange_strong(&parent[a], &expected, b))
+            return;
+    }
+}
+
+void *clusterThread(void *work) {
+    clusterWork *w = work;
+    clusterGrid *grid = w->grid;
+    int i, j, k, own, slot, reach, latCell, lonCell, timeCell, count, done;
+    double latitude;
+
+    for (i = w->start; i < w->end; i++) {
+        // Every row in a cell is within reach of every other, so the row's own cell needs no distance checks
+        own = grid->cellOf[i];
+        count = grid->counts[own];
+        if (w->pass == 0 && count >= grid->minPoints) {
+            grid->core[i] = 1;
+            continue;
+        }
+        if (w->pass == 1 && grid->cellCore[own] >= 0) {
+            if (!grid->core[i]) { // A border row joins a core row in its cell
+                grid->border[i] = grid->cellCore[own];
+                continue;
+            }
+            if (grid->cellCore[own] != i)
+                clusterUnion(grid->parent, i, grid->cellCore[own]);
+        }
+
+        // A degree of longitude gets shorter away from the equator, so more cells can be within reach
+        latitude = fabs(grid->rows[i]->latitude) + 2 * grid->cellDegrees;
+        reach = latitude >= 89 ? (int) (360 / grid->cellDegrees) : (int) ceil(2 / cos(latitude * M_PI / 180));
+        done = 0;
+        for (latCell = grid->latCells[i] - 2; latCell <= grid->latCells[i] + 2 && !done; latCell++) {
+            for (lonCell = grid->lonCells[i] - reach; lonCell <= grid->lonCells[i] + reach && !done; lonCell++) {
+                for (timeCell = grid->timeCells[i] - 2; timeCell <= grid->timeCells[i] + 2 && !done; timeCell++) {
+                    slot = gridCell(grid, cellKey(latCell, lonCell, timeCell), 0);
+                    if (slot < 0 || slot == own)
+                        continue;
+                    for (k = grid->starts[slot]; k < grid->starts[slot] + grid->counts[slot] && !done; k++) {
+                        j = grid->points[k];
+                        // Only core rows can be joined, and only if they aren't in the same cluster already
+                        if (w->pass == 1 && (!grid->core[j] ||
+                                             (grid->core[i] && clusterRoot(grid->parent, i) ==
+                                                               clusterRoot(grid->parent, j))))
+                            continue;
+                        if (labs(grid->minutes[i] - grid->minutes[j]) > grid->window ||
+                            clusterDistance(grid, i, j) > grid->distance)
+                            continue;
+                        if (w->pass == 0) {
+                            done = ++count >= grid->minPoints;
+                        } else if (grid->core[i]) {
+                            clusterUnion(grid->parent, i, j);
+                        } else { // A border row joins the first core row it finds
+                            grid->border[i] = j;
+                            done = 1;
+                        }
+                    }
                 }
+            }
+        }
+        if (w->pass == 0)
+            grid->core[i] = (char) (count >= grid->minPoints);
+    }
+    return NULL;
+}
+
+void printCluster(int id, clusterSummary *summary) {
+    printf("Cluster %d: %d sightings from %d/%d/%d %02d:%02d to %d/%d/%d %02d:%02d around %.4f, %.4f, mostly %s\n",
+           id, summary->count,
+           summary->first.date.month, summary->first.date.day, summary->first.date.year,
+           summary->first.hour, summary->first.minute,
+           summary->last.date.month, summary->last.date.day, summary->last.date.year,
+           summary->last.hour, summary->last.minute,
+           summary->latitude, summary->longitude, summary->shape[0] != '\0' ? summary->shape : "no shape");
+}
+
+void summarizeClusters(viewIndex *view, int labels[], int numClusters, clusterSummary summaries[]) {
+    dictionaryColumn shapes;
+    int *shapeCounts;
+    long *first = malloc((numClusters + 1) * sizeof(long));
+    long *last = malloc((numClusters + 1) * sizeof(long));
+    long minutes;
+    int *best = calloc(numClusters + 1, sizeof(int));
+    int i, c, shape;
+    sightingNode *node;
+
+    memset(&shapes, 0, sizeof(shapes));
+    startDictionary(&shapes, view->size);
+    for (i = 0; i < view->size; i++) // Give every shape an id first, to know how many counts each cluster needs
+        dictionaryId(&shapes, view->rows[i]->shape);
+    shapeCounts = calloc((long) numClusters * shapes.size + 1, sizeof(int));
+    for (c = 0; c < numClusters; c++) {
+        summaries[c].count = 0;
+        summaries[c].latitude = 0;
+        summaries[c].longitude = 0;
+    }
+
+    for (i = 0; i < view->size; i++) {
+        if (labels[i] == 0)
+            continue;
+        node = view->rows[i];
+        c = labels[i] - 1;
+        minutes = dayNumber(node->dateTime.date) * 1440 + node->dateTime.hour * 60 + node->dateTime.minute;
+        if (summaries[c].count == 0 || minutes < first[c]) {
+            first[c] = minutes;
+            summaries[c].first = node->dateTime;
+        }
+        if (summaries[c].count == 0 || minutes > last[c]) {
+            last[c] = minutes;
+            summaries[c].last = node->dateTime;
+        }
+        summaries[c].count++;
+        summaries[c].latitude += node->latitude;
+        summaries[c].longitude += node->longitude;
+        shape = dictionaryId(&shapes, node->shape);
+        if (++shapeCounts[(long) c * shapes.size + shape] > shapeCounts[(long) c * shapes.size + best[c]])
+            best[c] = shape;
+    }
+    for (c = 0; c < numClusters; c++) {
+        summaries[c].latitude /= summaries[c].count;
+        summaries[c].longitude /= summaries[c].count;
+        strcpy(summaries[c].shape, shapes.values[best[c]]);
+    }
+
+    freeDictionary(&shapes);
+    free(shapeCounts);
+    free(best);
+    free(first);
+    free(last);
+}
+
+void viewClusters(viewIndex *results, viewIndex *view, int labels[], int numClusters) {
+    int *starts = calloc(numClusters + 2, sizeof(int));
+    int i, noise;
+
+    for (i = 0; i < view->size; i++) // Count the rows of each cluster
+        starts[labels[i] + 1]++;
+    for (i = 1; i <= numClusters + 1; i++) // Rows of cluster c start after the rows of every cluster before it
+        starts[i] += starts[i - 1];
+    noise = starts[1]; // Rows that are in no cluster are left out
+    results->size = 0;
+    for (i = noise; i < starts[numClusters + 1]; i++)
+        viewAppend(results, NULL);
+    for (i = 0; i < view->size; i++)
+        if (labels[i] > 0)
+            results->rows[starts[labels[i]]++ - noise] = view->rows[i];
+    free(starts);
+}
+
+void flatAddOffset(flatBuilder *builder, int slot, long offset) {
+    flatPrep(builder, 4, 0);
+    flatPushScalar(builder, builder->size + 4 - offset, 4); // Objects are found by their distance forward
+    builder->fields[slot] = builder->size;
+    if (slot >= builder->numFields)
+        builder->numFields = slot + 1;
+}
+
+void flatAddScalar(flatBuilder *builder, int slot, long long value, int size) {
+    flatPrep(builder, size, 0);
+    flatPushScalar(builder, value, size);
+    builder->fields[slot] = builder->size;
+    if (slot >= builder->numFields)
+        builder->numFields = slot + 1;
+}
+
+void flatFinish(flatBuilder *builder, long root) {
+    flatPrep(builder, builder->minAlign, 4);
+    flatPushScalar(builder, builder->size + 4 - root, 4);
+}
+
+void flatPrep(flatBuilder *builder, int align, long additional) {
+    unsigned char zeros[8] = {0};
+    long padding = -(builder->size + additional) & (align - 1);
+    if (align > builder->minAlign)
+        builder->minAlign = align;
+    if (padding > 0)
+        flatPush(builder, zeros, padding);
+}
+
+void flatPush(flatBuilder *builder, const void *bytes, long size) {
+    unsigned char *grown;
+    long capacity = builder->capacity ? builder->capacity : 1024;
+    if (builder->size + size > builder->capacity) { // Move what is there to the end of a bigger buffer
+        while (builder->size + size > capacity)
+            capacity *= 2;
+        grown = malloc(capacity);
+        if (builder->bytes != NULL) {
+            memcpy(grown + capacity - builder->size, builder->bytes + builder->capacity - builder->size, builder->size);
+            free(builder->bytes);
+        }
+        builder->bytes = grown;
+        builder->capacity = capacity;
+    }
+    builder->size += size;
+    memcpy(builder->bytes + builder->capacity - builder->size, bytes, size);
+}
+
+void flatPushScalar(flatBuilder *builder, long long value, int size) {
+    unsigned char bytes[8];
+    int i;
+    for (i = 0; i < size; i++)
+        bytes[i] = (unsigned char) ((unsigned long long) value >> (8 * i));
+    flatPush(builder, bytes, size);
+}
+
+void flatStartTable(flatBuilder *builder) {
+    memset(builder->fields, 0, sizeof(builder->fields));
+    builder->numFields = 0;
+    builder->tableStart = builder->size;
+}
+
+void arrowBuffer(long long buffers[], int *numBuffers, long long *bodyLength, long long length) {
+    buffers[*numBuffers * 2] = *bodyLength;
+    buffers[*numBuffers * 2 + 1] = length;
+    (*numBuffers)++;
+    *bodyLength += (length + 7) & ~7LL;
+}
+
+void arrowPad(FILE *file, long long length) {
+    char zeros[8] = {0};
+    fwrite(zeros, 1, (8 - length % 8) % 8, file);
+}
+
+void arrowWriteStrings(FILE *file, char *strings[], int count) {
+    int offset = 0;
+    int i;
+    fwrite(&offset, sizeof(int), 1, file);
+    for (i = 0; i < count; i++) { // Where each string ends in the bytes
+        offset += (int) strlen(strings[i]);
+        fwrite(&offset, sizeof(int), 1, file);
+    }
+    arrowPad(file, (count + 1) * 4LL);
+    for (i = 0; i < count; i++)
+        fwrite(strings[i], 1, strlen(strings[i]), file);
+    arrowPad(file, offset);
+}
+
+void saveField(FILE *file, char field[]) {
+    char *c;
+    if (strpbrk(field, ",\"\r\n") == NULL) {
+        fputs(field, file);
+        return;
+    }
+    fputc('"', file);
+    for (c = field; *c != '\0'; c++) {
+        if (*c == '"')
+            fputc('"', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+void stopSignal(int number) {
+    (void) number;
+}
+
+void heapOffer(topKHeap *heap, int index) {
+    int i, parent, tmp;
+    if (heap->size < heap->k) { // Until the heap is full, keep everything and move it up to its place
+        i = heap->size++;
+        heap->heap[i] = index;
+        while (i > 0) {
+            parent = (i - 1) / 2;
+            if (sortsBefore(heap->rows, heap->heap[parent], heap->heap[i], heap->dir, heap->function)) {
+                tmp = heap->heap[parent];
+                heap->heap[parent] = heap->heap[i];
+                heap->heap[i] = tmp;
+                i = parent;
+            } else {
                 break;
-            case 'a': // Add entry option
-                state = 1;
-                addEntry(&headNode);
-                viewingNode = headNode;
-                viewingLocation = 0;
-                size++;
-                printList(viewingNode, MAX_SEARCH_RESULTS);
-                if (viewingLocation + 10 >= size) // If they are viewing the last 10 (or fewer) items, indicate that
-                    printf("End of data\n");
-                break;
-            case 'r': // Remove entry option
-                state = 1;
-                size -= removeEntry(&viewingNode); // Only decrease size if the item was removed successfully
-                printList(viewingNode, MAX_SEARCH_RESULTS);
-                if (viewingLocation + 10 >= size) // If they are viewing the last 10 (or fewer) items, indicate that
-                    printf("End of data\n");
-                break;
-            case 's': // Save option
-                if (saveData(headNode))
-                    state = 0;
+            }
+        }
+    } else if (sortsBefore(heap->rows, index, heap->heap[0], heap->dir, heap->function)) {
+        heap->heap[0] = index; // Replace the worst kept row
+        heapSiftDown(heap);
+    }
+}
+
+void heapSiftDown(topKHeap *heap) {
+    int i = 0, child, tmp;
+    while ((child = 2 * i + 1) < heap->size) {
+        // Pick whichever child sorts last, since it belongs nearer the root
+        if (child + 1 < heap->size &&
+            sortsBefore(heap->rows, heap->heap[child], heap->heap[child + 1], heap->dir, heap->function))
+            child++;
+        if (!sortsBefore(heap->rows, heap->heap[i], heap->heap[child], heap->dir, heap->function))
+            break;
+        tmp = heap->heap[child];
+        heap->heap[child] = heap->heap[i];
+        heap->heap[i] = tmp;
+        i = child;
+    }
+}
+
+unsigned long long hashString(unsigned long long hash, char string[]) {
+    while (*string != '\0') {
+        hash ^= (unsigned char) *string++;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+void printArray(sightingNode *arr[], int size) {
+    int i = 0;
+    while (i < size && arr[i] != NULL) {
+        printf("(%d) ", i);
+        printNode(arr[i]);
+        printf("\n");
+        i++;
+    }
+}
+
+void printPage(viewIndex *view, int location) {
+    int count = view->size - location;
+    if (count > MAX_SEARCH_RESULTS)
+        count = MAX_SEARCH_RESULTS;
+    printf("Rows %d-%d of %d\n", count > 0 ? location + 1 : location, location + count, view->size);
+    printArray(view->rows + location, count);
+    if (location + MAX_SEARCH_RESULTS >= view->size) // If they are viewing the last 10 (or fewer) items, indicate that
+        printf("End of data\n");
+}
+
+void printNode(sightingNode *node) {
+    printf("%d/%d/%d at %02d:%02d in %s (%s, %s): %s for %d seconds; \"%s...\"",
+           node->dateTime.date.month,
+           node->dateTime.date.day,
+           node->dateTime.date.year,
+           node->dateTime.hour,
+           node->dateTime.minute,
+           node->city,
+           node->state,
+           node->country,
+           node->shape,
+           node->duration,
+           node->comment
+    );
+}
+
+void searchByDate(viewIndex *results, sightingNode *head, filterCache *cache, datePredicate predicate, date d) {
+    int fresh;
+    filterCacheEntry *entry = findFilter(cache, NULL, "", predicate, d, &fresh);
+    searchCached(results, head, cache, entry, fresh);
+}
+
+void searchByString(viewIndex *results, sightingNode *head, filterCache *cache, stringPredicate predicate,
+                    char string[]) {
+    int fresh;
+    date none = {0, 0, 0};
+    filterCacheEntry *entry = findFilter(cache, predicate, string, NULL, none, &fresh);
+    searchCached(results, head, cache, entry, fresh);
+}
+
+void searchCached(viewIndex *results, sightingNode *head, filterCache *cache, filterCacheEntry *entry, int fresh) {
+    unsigned int bits;
+    int i, id;
+
+    if (cache->stale)
+        renumberFilters(cache, head, fresh ? entry : NULL);
+    else if (fresh) // Use the filter to check every row
+        for (id = 1; id <= cache->nextId; id++)
+            setFilterBit(entry, id, filterMatches(entry, cache->nodes[id]));
+
+    // Ids follow the list, so going through the set bits in order keeps the rows in list order
+    results->size = 0;
+    for (i = 0; i < entry->bytes && i * 8 <= cache->nextId; i++) {
+        bits = entry->bits[i];
+        while (bits != 0) {
+            id = i * 8 + __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (id >= 1 && id <= cache->nextId)
+                viewAppend(results, cache->nodes[id]);
+        }
+    }
+}
+
+void renumberFilters(filterCache *cache, sightingNode *head, filterCacheEntry *fresh) {
+    unsigned char *bits[FILTER_CACHE_SIZE];
+    filterCacheEntry *entry;
+    sightingNode *node;
+    int count = 0, bytes, old, value, i;
+
+    for (node = head; node != NULL; node = node->next)
+        count++;
+    cache->nodes = realloc(cache->nodes, (count + 1) * sizeof(sightingNode *));
+    bytes = count / 8 + 1;
+    for (i = 0; i < cache->size; i++)
+        bits[i] = calloc(bytes, 1);
+
+    count = 0;
+    for (node = head; node != NULL; node = node->next) {
+        old = node->id;
+        node->id = ++count;
+        cache->nodes[count] = node;
+        for (i = 0; i < cache->size; i++) {
+            entry = &cache->entries[i];
+            // Rows the cache has not seen, or every row of a new entry, have to be checked
+            if (entry == fresh || old == 0 || old / 8 >= entry->bytes)
+                value = filterMatches(entry, node);
+            else
+                value = entry->bits[old / 8] >> old % 8 & 1;
+            if (value)
+                bits[i][count / 8] |= (unsigned char) (1 << count % 8);
+        }
+    }
+    for (i = 0; i < cache->size; i++) {
+        free(cache->entries[i].bits);
+        cache->entries[i].bits = bits[i];
+        cache->entries[i].bytes = bytes;
+    }
+    cache->nextId = count;
+    cache->stale = 0;
+}
+
+void setFilterBit(filterCacheEntry *entry, int id, int value) {
+    int bytes = entry->bytes;
+    if (id / 8 >= entry->bytes) {
+        while (id / 8 >= bytes)
+            bytes = bytes ? bytes * 2 : 1024;
+        entry->bits = realloc(entry->bits, bytes);
+        memset(entry->bits + entry->bytes, 0, bytes - entry->bytes);
+        entry->bytes = bytes;
+    }
+    if (value)
+        entry->bits[id / 8] |= (unsigned char) (1 << id % 8);
+    else
+        entry->bits[id / 8] &= (unsigned char) ~(1 << id % 8);
+}
+
+unsigned long long simHash(char comment[]) {
+    int weights[64] = {0};
+    unsigned long long hash;
+    unsigned long long out = 0;
+    char *c = comment;
+    int i;
+
+    while (*c != '\0') {
+        // Hash each word, ignoring case and punctuation, and let it vote on every bit
+        hash = FNV_OFFSET;
+        while ((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9')) {
+            hash ^= (unsigned char) (*c >= 'A' && *c <= 'Z' ? *c - 'A' + 'a' : *c);
+            hash *= FNV_PRIME;
+            c++;
+        }
+        if (hash != FNV_OFFSET)
+            for (i = 0; i < 64; i++)
+                weights[i] += (hash >> i) & 1 ? 1 : -1;
+        if (*c != '\0')
+            c++;
+    }
+    // Each bit of the SimHash is whichever way most of the words voted
+    for (i = 0; i < 64; i++)
+        if (weights[i] > 0)
+            out |= 1ULL << i;
+    return out;
+}
+
+void sortBy(sightingNode **head, int size, int dir, compare function) {
+    // Carry out merge sort on an array of the nodes, then relink the list in the new order
+    sightingNode **rows = malloc(size * sizeof(sightingNode *));
+    sightingNode **buffer = malloc(size * sizeof(sightingNode *));
+    sightingNode *node = *head;
+    int i;
+
+    for (i = 0; i < size && node != NULL; i++) {
+        rows[i] = node;
+        node = node->next;
+    }
+    size = i;
+    mergeSort(rows, buffer, size, dir, function);
+    for (i = 0; i < size; i++)
+        rows[i]->next = i + 1 < size ? rows[i + 1] : NULL;
+    if (size > 0)
+        *head = rows[0];
+    free(rows);
+    free(buffer);
+}
+
+void topK(viewIndex *results, viewIndex *view, int k, int dir, compare function) {
+    topKHeap final;
+    topKHeap *heaps;
+    pthread_t *threads;
+    long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int i, j;
+
+    // No more rows can be kept than the view has, and the heaps need room for at least one
+    if (k > view->size)
+        k = view->size;
+    if (k < 1)
+        k = 1;
+    final = (topKHeap) {view->rows, 0, view->size, k, dir, function, malloc(k * sizeof(int)), 0};
+    if (numThreads > view->size / TOP_K_MIN_ROWS_PER_THREAD)
+        numThreads = view->size / TOP_K_MIN_ROWS_PER_THREAD;
+    if (numThreads <= 1) { // Not worth splitting up, so use one heap over the whole view
+        topKThread(&final);
+    } else {
+        // Give each thread its own heap over an equal share of the view
+        heaps = malloc(numThreads * sizeof(topKHeap));
+        threads = malloc(numThreads * sizeof(pthread_t));
+        for (i = 0; i < numThreads; i++) {
+            heaps[i] = final;
+            heaps[i].start = (int) (view->size * i / numThreads);
+            heaps[i].end = (int) (view->size * (i + 1) / numThreads);
+            heaps[i].heap = malloc(k * sizeof(int));
+            pthread_create(&threads[i], NULL, topKThread, &heaps[i]);
+        }
+        // The best k rows overall are among the best k of each share
+        for (i = 0; i < numThreads; i++) {
+            pthread_join(threads[i], NULL);
+            for (j = 0; j < heaps[i].size; j++)
+                heapOffer(&final, heaps[i].heap[j]);
+            free(heaps[i].heap);
+        }
+        free(heaps);
+        free(threads);
+    }
+
+    // Taking the root each time gives the rows from last to first
+    results->size = 0;
+    for (i = 0; i < final.size; i++)
+        viewAppend(results, NULL);
+    while (final.size > 0) {
+        results->rows[final.size - 1] = view->rows[final.heap[0]];
+        final.heap[0] = final.heap[--final.size];
+        heapSiftDown(&final);
+    }
+    free(final.heap);
+}
+
+void *topKThread(void *heap) {
+    topKHeap *h = heap;
+    int i;
+    for (i = h->start; i < h->end; i++)
+        heapOffer(h, i);
+    return NULL;
+}
+
+void viewAppend(viewIndex *view, sightingNode *node) {
+    if (view->size == view->capacity) { // Double the array when it runs out of room
+        view->capacity = view->capacity ? view->capacity * 2 : 64;
+        view->rows = realloc(view->rows, view->capacity * sizeof(sightingNode *));
+    }
+    view->rows[view->size++] = node;
+}
+
+void saveList(FILE *file, sightingNode *head) {
+    sightingNode *node = head;
+    while (node != NULL) {
+        saveNode(file, node);
+        fprintf(file, "\n");
+        node = node->next;
+    }
+}
+
+void saveNode(FILE *file, sightingNode *node) {
+    fprintf(file, "%d/%d/%d %02d:%02d,",
+            node->dateTime.date.month,
+            node->dateTime.date.day,
+            node->dateTime.date.year,
+            node->dateTime.hour,
+            node->dateTime.minute
+    );
+    saveField(file, node->city);
+    fputc(',', file);
+    saveField(file, node->state);
+    fputc(',', file);
+    saveField(file, node->country);
+    fputc(',', file);
+    saveField(file, node->shape);
+    fprintf(file, ",%d,", node->duration);
+    saveField(file, node->comment);
+    fprintf(file, ",%d/%d/%d,%.7f,%.7f", // The data has up to 7 decimals, so every one is kept
+            node->dateReported.month,
+            node->dateReported.day,
+            node->dateReported.year,
+            node->latitude,
+            node->longitude
+    );
+}
+
+int sortsBefore(sightingNode **rows, int a, int b, int dir, compare function) {
+    int result = function(rows[a], rows[b], dir);
+    if (result == 0) // Break ties by position so the order matches a stable sort
+        return a < b;
+    return result < 0;
+}
+
+int compressData(columnStore *store, sightingNode *head) {
+    sightingNode *node;
+    byteBuffer block = {NULL, 0, 0}; // Comments of the block being filled
+    int *ids[4];
+    dictionaryColumn *columns[] = {&store->cities, &store->states, &store->countries, &store->shapes};
+    long long occurred, reported, prevOccurred = 0, prevReported = 0;
+    int rows = 0, skipped = 0, i;
+
+    memset(store, 0, sizeof(columnStore));
+    for (node = head; node != NULL; node = node->next)
+        rows++;
+    for (i = 0; i < 4; i++) {
+        ids[i] = malloc((rows + 1) * sizeof(int));
+        startDictionary(columns[i], rows);
+    }
+
+    for (node = head; node != NULL; node = node->next) {
+        occurred = dateKey(node->dateTime.date);
+        reported = dateKey(node->dateReported);
+        if (occurred < 0 || reported < 0 || node->dateTime.hour < 0 || node->dateTime.hour > 24 ||
+            node->dateTime.minute < 0 || node->dateTime.minute > 59) {
+            skipped++;
+            continue;
+        }
+        // Rows tend to be near the row before, so the differences are small
+        occurred = occurred * TIME_SLOTS + node->dateTime.hour * 60 + node->dateTime.minute;
+        putVarint(&store->occurred, occurred - prevOccurred);
+        prevOccurred = occurred;
+        putVarint(&store->reported, reported - prevReported);
+        prevReported = reported;
+        putVarint(&store->durations, node->duration);
+        putVarint(&store->coordinates, (long long) (node->longitude * 1e7 + (node->longitude < 0 ? -0.5 : 0.5)));
+        putVarint(&store->coordinates, (long long) (node->latitude * 1e7 + (node->latitude < 0 ? -0.5 : 0.5)));
+        ids[0][store->size] = dictionaryId(&store->cities, node->city);
+        ids[1][store->size] = dictionaryId(&store->states, node->state);
+        ids[2][store->size] = dictionaryId(&store->countries, node->country);
+        ids[3][store->size] = dictionaryId(&store->shapes, node->shape);
+        bufferAppend(&block, node->comment, (long) strlen(node->comment) + 1);
+        store->size++;
+        if (store->size % COMMENT_BLOCK_ROWS == 0)
+            flushCommentBlock(&store->comments, &block);
+    }
+    if (block.size > 0)
+        flushCommentBlock(&store->comments, &block);
+
+    for (i = 0; i < 4; i++) { // Now that every value is known, the ids can be packed
+        packIds(columns[i], ids[i], store->size);
+        free(ids[i]);
+        free(columns[i]->table);
+        columns[i]->table = NULL;
+    }
+    free(block.bytes);
+    return skipped;
+}
+
+long columnBytes(columnStore *store) {
+    dictionaryColumn *columns[] = {&store->cities, &store->states, &store->countries, &store->shapes};
+    long bytes = sizeof(columnStore) + store->occurred.size + store->reported.size + store->durations.size +
+                 store->coordinates.size + store->comments.size;
+    int i, j;
+    for (i = 0; i < 4; i++) {
+        bytes += columns[i]->ids.size + columns[i]->size * (long) sizeof(char *);
+        for (j = 0; j < columns[i]->size; j++)
+            bytes += (long) strlen(columns[i]->values[j]) + 1;
+    }
+    return bytes;
+}
+
+long long dateKey(date d) {
+    if (d.year < 0 || d.month < 1 || d.month > 12 || d.day < 1 || d.day > 31)
+        return -1;
+    return ((long long) d.year * 12 + d.month - 1) * 31 + d.day - 1;
+}
+
+int dictionaryId(dictionaryColumn *column, char value[]) {
+    int slot = (int) (hashString(FNV_OFFSET, value) & (column->tableSize - 1));
+    while (column->table[slot] != -1) {
+        if (strcmp(column->values[column->table[slot]], value) == 0)
+            return column->table[slot];
+        slot = (slot + 1) & (column->tableSize - 1);
+    }
+    if (column->size == column->capacity) {
+        column->capacity = column->capacity ? column->capacity * 2 : 16;
+        column->values = realloc(column->values, column->capacity * sizeof(char *));
+    }
+    column->values[column->size] = malloc(strlen(value) + 1);
+    strcpy(column->values[column->size], value);
+    column->table[slot] = column->size;
+    return column->size++;
+}
+
+int getBuffer(unsigned char **cursor, unsigned char *end, byteBuffer *section) {
+    long size;
+    if (*cursor >= end)
+        return 0;
+    size = (long) getVarint(cursor);
+    if (size < 0 || size > end - *cursor)
+        return 0;
+    section->bytes = calloc(size + 8, 1); // Room for unpackId to read past the end
+    memcpy(section->bytes, *cursor, size);
+    section->size = size;
+    section->capacity = size + 8;
+    *cursor += size;
+    return 1;
+}
+
+long long getVarint(unsigned char **cursor) {
+    unsigned long long zigzag = 0;
+    int shift = 0;
+    do {
+        zigzag |= (unsigned long long) (**cursor & 0x7f) << shift;
+        shift += 7;
+    } while (*(*cursor)++ & 0x80 && shift < 64);
+    return (long long) (zigzag >> 1) ^ -(long long) (zigzag & 1);
+}
+
+int loadColumns(char fileName[], columnStore *store) {
+    FILE *file = fopen(fileName, "rb");
+    byteBuffer contents = {NULL, 0, 0};
+    dictionaryColumn *columns[] = {&store->cities, &store->states, &store->countries, &store->shapes};
+    unsigned char chunk[4096];
+    unsigned char *cursor, *end, *nul;
+    long read;
+    int loaded = 1, i, j;
+
+    memset(store, 0, sizeof(columnStore));
+    if (file == NULL)
+        return 0;
+    while ((read = (long) fread(chunk, 1, sizeof(chunk), file)) > 0)
+        bufferAppend(&contents, chunk, read);
+    fclose(file);
+    if (contents.size < (long) strlen(COLUMN_MAGIC) ||
+        memcmp(contents.bytes, COLUMN_MAGIC, strlen(COLUMN_MAGIC)) != 0) {
+        free(contents.bytes);
+        return 0;
+    }
+    bufferAppend(&contents, "\0\0\0\0\0\0\0\0\0\0", 10); // So a cut off varint can't be read past the end
+    cursor = contents.bytes + strlen(COLUMN_MAGIC);
+    end = contents.bytes + contents.size - 10;
+
+    store->size = (int) getVarint(&cursor);
+    for (i = 0; i < 4 && loaded; i++) {
+        columns[i]->size = columns[i]->capacity = (int) getVarint(&cursor);
+        if (columns[i]->size < 0 || columns[i]->size > end - cursor) {
+            columns[i]->size = 0;
+            loaded = 0;
+            break;
+        }
+        columns[i]->values = malloc((columns[i]->size + 1) * sizeof(char *));
+        for (j = 0; j < columns[i]->size; j++) {
+            nul = memchr(cursor, '\0', end - cursor);
+            if (nul == NULL) {
+                columns[i]->size = j;
+                loaded = 0;
                 break;
-            case 'q': // Quit option
-                printf("Exiting program...");
-                state = 0;
+            }
+            columns[i]->values[j] = malloc(nul - cursor + 1);
+            strcpy(columns[i]->values[j], (char *) cursor);
+            cursor = nul + 1;
+        }
+        columns[i]->bits = (int) getVarint(&cursor);
+        loaded = loaded && columns[i]->bits >= 0 && columns[i]->bits < 31 &&
+                 getBuffer(&cursor, end, &columns[i]->ids) &&
+                 columns[i]->ids.size >= ((long) store->size * columns[i]->bits + 7) / 8;
+    }
+    loaded = loaded && store->size >= 0 &&
+             getBuffer(&cursor, end, &store->occurred) && getBuffer(&cursor, end, &store->reported) &&
+             getBuffer(&cursor, end, &store->durations) && getBuffer(&cursor, end, &store->coordinates) &&
+             getBuffer(&cursor, end, &store->comments) && checkColumns(store);
+    for (i = 0; i < 4 && loaded; i++) // Every id has to name a value
+        for (j = 0; j < store->size && loaded; j++)
+            loaded = unpackId(columns[i], j) < columns[i]->size;
+    free(contents.bytes);
+    if (!loaded)
+        freeColumns(store);
+    return loaded;
+}
+
+int saveColumns(char fileName[], columnStore *store) {
+    FILE *file = fopen(fileName, "wb");
+    byteBuffer contents = {NULL, 0, 0};
+    dictionaryColumn *columns[] = {&store->cities, &store->states, &store->countries, &store->shapes};
+    int saved, i, j;
+
+    if (file == NULL)
+        return 0;
+    bufferAppend(&contents, COLUMN_MAGIC, (long) strlen(COLUMN_MAGIC));
+    putVarint(&contents, store->size);
+    for (i = 0; i < 4; i++) {
+        putVarint(&contents, columns[i]->size);
+        for (j = 0; j < columns[i]->size; j++)
+            bufferAppend(&contents, columns[i]->values[j], (long) strlen(columns[i]->values[j]) + 1);
+        putVarint(&contents, columns[i]->bits);
+        putBuffer(&contents, &columns[i]->ids);
+    }
+    putBuffer(&contents, &store->occurred);
+    putBuffer(&contents, &store->reported);
+    putBuffer(&contents, &store->durations);
+    putBuffer(&contents, &store->coordinates);
+    putBuffer(&contents, &store->comments);
+    saved = fwrite(contents.bytes, 1, contents.size, file) == (size_t) contents.size;
+    saved = fclose(file) == 0 && saved;
+    free(contents.bytes);
+    return saved;
+}
+
+int searchColumns(columnStore *store, char field, char value[], char wanted[]) {
+    sightingNode scratch; // Holds one dictionary value at a time for the predicate
+    dictionaryColumn *column;
+    stringPredicate predicate;
+    char *scratchField;
+    int scratchSize;
+    char *matches;
+    unsigned char *cursor;
+    long long key, current = 0;
+    date d;
+    int count = 0, i;
+
+    memset(wanted, 0, store->size);
+    switch (field) {
+        case 'd':
+        case 'p':
+            if (sscanf(value, "%d/%d/%d", &d.month, &d.day, &d.year) != 3 || (key = dateKey(d)) < 0)
+                return -1;
+            cursor = field == 'd' ? store->occurred.bytes : store->reported.bytes;
+            for (i = 0; i < store->size; i++) {
+                current += getVarint(&cursor);
+                wanted[i] = (char) ((field == 'd' ? current / TIME_SLOTS : current) == key);
+                count += wanted[i];
+            }
+            return count;
+        case 't':
+            column = &store->cities;
+            predicate = cityPredicate;
+            scratchField = scratch.city;
+            scratchSize = MAX_CITY;
+            break;
+        case 's':
+            column = &store->states;
+            predicate = statePredicate;
+            scratchField = scratch.state;
+            scratchSize = sizeof(scratch.state);
+            break;
+        case 'c':
+            column = &store->countries;
+            predicate = countryPredicate;
+            scratchField = scratch.country;
+            scratchSize = sizeof(scratch.country);
+            break;
+        case 'h':
+            column = &store->shapes;
+            predicate = shapePredicate;
+            scratchField = scratch.shape;
+            scratchSize = MAX_SHAPE;
+            break;
+        default:
+            return -1;
+    }
+
+    matches = malloc(column->size + 1);
+    for (i = 0; i < column->size; i++) {
+        strncpy(scratchField, column->values[i], scratchSize - 1);
+        scratchField[scratchSize - 1] = '\0';
+        matches[i] = (char) predicate(&scratch, value);
+    }
+    for (i = 0; i < store->size; i++) {
+        wanted[i] = matches[unpackId(column, i)];
+        count += wanted[i];
+    }
+    free(matches);
+    return count;
+}
+
+int unpackId(dictionaryColumn *column, int row) {
+    long bit = (long) row * column->bits;
+    unsigned char *bytes = column->ids.bytes + bit / 8;
+    unsigned long long word = 0;
+    int i;
+    if (column->bits == 0) // Only one value
+        return 0;
+    for (i = 7; i >= 0; i--)
+        word = word << 8 | bytes[i];
+    return (int) (word >> bit % 8 & ((1ULL << column->bits) - 1));
+}
+
+long writeColumns(columnStore *store, FILE *file, char wanted[]) {
+    sightingNode node;
+    columnCursor cursor;
+    long written = 0;
+
+    int row;
+
+    openCursor(&cursor, store, wanted);
+    while (cursor.row < store->size) {
+        row = cursor.row;
+        if (!readColumns(store, &cursor, &node)) { // Every row is read, since the dates depend on the row before
+            written = -1;
+            break;
+        }
+        if (wanted == NULL || wanted[row]) {
+            saveNode(file, &node);
+            fprintf(file, "\n");
+            written++;
+        }
+    }
+    free(cursor.block);
+    return written;
+}
+
+filterCacheEntry *findFilter(filterCache *cache, stringPredicate stringSearch, char string[], datePredicate dateSearch,
+                             date d, int *fresh) {
+    filterCacheEntry *entry = NULL;
+    int i;
+
+    for (i = 0; i < cache->size; i++) {
+        entry = &cache->entries[i];
+        if (entry->stringSearch == stringSearch && entry->dateSearch == dateSearch &&
+            (stringSearch != NULL ? strcmp(entry->string, string) == 0 :
+             entry->d.year == d.year && entry->d.month == d.month && entry->d.day == d.day)) {
+            entry->lastUsed = ++cache->clock;
+            *fresh = 0;
+            return entry;
+        }
+    }
+
+    if (cache->size < FILTER_CACHE_SIZE) {
+        entry = &cache->entries[cache->size++];
+        entry->bits = NULL;
+        entry->bytes = 0;
+    } else { // Reuse the bitmap of the entry used longest ago
+        entry = &cache->entries[0];
+        for (i = 1; i < cache->size; i++)
+            if (cache->entries[i].lastUsed < entry->lastUsed)
+                entry = &cache->entries[i];
+        memset(entry->bits, 0, entry->bytes);
+    }
+    entry->stringSearch = stringSearch;
+    strncpy(entry->string, string, MAX_SEARCH_STRING - 1);
+    entry->string[MAX_SEARCH_STRING - 1] = '\0';
+    entry->dateSearch = dateSearch;
+    entry->d = d;
+    entry->lastUsed = ++cache->clock;
+    *fresh = 1;
+    return entry;
+}
+
+int filterMatches(filterCacheEntry *entry, sightingNode *node) {
+    if (entry->stringSearch != NULL)
+        return entry->stringSearch(node, entry->string);
+    return entry->dateSearch(node, entry->d);
+}
+
+int benchServer(char socketName[], int threads, int queries) {
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    benchWorker *workers = malloc(threads * sizeof(benchWorker));
+    double *latencies = malloc((long) threads * queries * sizeof(double) + 1);
+    double start, elapsed;
+    long total = (long) threads * queries;
+    int failed = 0, i;
+
+    i = connectServer(socketName);
+    if (i < 0) {
+        printf("Could not connect to %s\n", socketName);
+        free(latencies);
+        free(workers);
+        free(ids);
+        return 0;
+    }
+    close(i);
+    start = secondsNow();
+    for (i = 0; i < threads; i++) {
+        workers[i].socketName = socketName;
+        workers[i].queries = queries;
+        workers[i].seed = (unsigned int) i + 1;
+        workers[i].latencies = latencies + (long) i * queries;
+        pthread_create(&ids[i], NULL, benchThread, &workers[i]);
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        failed += workers[i].failed;
+    }
+    elapsed = secondsNow() - start;
+
+    qsort(latencies, total, sizeof(double), latencyCompare);
+    printf("%ld queries over %d connections in %.2f seconds: %.0f queries per second\n",
+           total, threads, elapsed, total / elapsed);
+    printf("Latency: median %.2f ms, 99th percentile %.2f ms, 99.9th percentile %.2f ms, max %.2f ms\n",
+           latencies[total / 2] * 1000, latencies[total * 99 / 100] * 1000, latencies[total * 999 / 1000] * 1000,
+           latencies[total - 1] * 1000);
+    if (failed > 0)
+        printf("%d queries failed\n", failed);
+    free(latencies);
+    free(workers);
+    free(ids);
+    return failed == 0;
+}
+
+int connectServer(char socketName[]) {
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketName, sizeof(address.sun_path) - 1);
+    if (fd >= 0 && connect(fd, (struct sockaddr *) &address, sizeof(address)) == 0)
+        return fd;
+    if (fd >= 0)
+        close(fd);
+    return -1;
+}
+
+int countCompare(const void *a, const void *b) {
+    const int *p1 = a, *p2 = b;
+    if (p1[0] != p2[0])
+        return p1[0] < p2[0] ? 1 : -1;
+    return p1[1] - p2[1]; // Ties keep the order the values were first seen in
+}
+
+int latencyCompare(const void *a, const void *b) {
+    double l1 = *(const double *) a, l2 = *(const double *) b;
+    return (l1 > l2) - (l1 < l2);
+}
+
+int queryServerOnce(char request[], FILE *input, FILE *output, FILE *answer) {
+    char *line = NULL;
+    int capacity = 0;
+    int open;
+    int result = 0;
+
+    fputs(request, output);
+    fflush(output);
+    // Rows in the answer are read whole, so a line of a quoted comment is never taken for the end
+    while (readRecord(input, &line, &capacity, &open) > 0) {
+        if (answer != NULL)
+            fputs(line, answer);
+        if (strncmp(line, "END", 3) == 0) {
+            result = 1;
+            break;
+        }
+        if (strncmp(line, "ERROR", 5) == 0)
+            break;
+    }
+    free(line);
+    return result;
+}
+
+int runClient(char socketName[]) {
+    char *request = NULL;
+    int capacity = 0;
+    int length;
+    int open;
+    int socket = connectServer(socketName);
+    int interactive = isatty(STDIN_FILENO);
+    FILE *input, *output;
+
+    if (socket < 0) {
+        printf("Could not connect to %s\n", socketName);
+        return 0;
+    }
+    input = fdopen(socket, "r");
+    output = fdopen(dup(socket), "w");
+    if (interactive)
+        printf("Commands: filter d|t|s|c|h|p value, sort field [rows], count t|s|c|h, add row, remove row, size\n> ");
+    while ((length = readRecord(stdin, &request, &capacity, &open)) > 0) {
+        while (length > 0 && (request[length - 1] == '\n' || request[length - 1] == '\r'))
+            length--;
+        if (length > 0) { // readRecord always leaves room after the row for a newline
+            request[length] = '\n';
+            request[length + 1] = '\0';
+            if (!queryServerOnce(request, input, output, stdout) && feof(input)) {
+                printf("The server closed the connection\n");
                 break;
+            }
         }
+        if (interactive)
+            printf("> ");
     }
+    free(request);
+    fclose(output);
+    fclose(input);
+    return 1;
+}
 
-    freeData(headNode);
-    return 0;
+int serveData(char fileName[], char socketName[]) {
+    queryServer server;
+    serverConnection *connection;
+    struct sockaddr_un address;
+    char journalName[MAX_LINE];
+    pthread_t thread;
+    struct sigaction stop;
+    sigset_t signals, oldSignals;
+    long offset;
+    int fd, client, created, i;
+
+    if (strlen(socketName) >= sizeof(address.sun_path)) {
+        printf("The socket name %s is too long\n", socketName);
+        return 0;
+    }
+    memset(&server, 0, sizeof(server));
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        printf("There is no file called %s\n", fileName);
+        return 0;
+    }
+    close(fd);
+    server.head = malloc(sizeof(sightingNode));
+    server.size = loadData(fileName, server.head, &offset, 0);
+    if (server.size == 0) {
+        free(server.head);
+        server.head = NULL;
+    }
+    // Load the changes other runs made too, and keep recording them the same way
+    snprintf(journalName, sizeof(journalName), "%s%s", fileName, JOURNAL_EXTENSION);
+    server.size += replayJournal(journalName, &server.head);
+    server.journal = fopen(journalName, "a");
+    if (server.journal == NULL) { // Changes could not be kept, so don't accept them
+        printf("Could not open %s\n", journalName);
+        return 0;
+    }
+    buildView(&server.view, server.head);
+    pthread_rwlock_init(&server.lock, NULL);
+    pthread_mutex_init(&server.writeLock, NULL);
+    pthread_mutex_init(&server.connectionsLock, NULL);
+    pthread_cond_init(&server.connectionsDone, NULL);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketName);
+    unlink(socketName); // Left behind by a server that was stopped
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        printf("Could not listen on %s\n", socketName);
+        return 0;
+    }
+    signal(SIGPIPE, SIG_IGN); // A client that leaves early should not stop the server
+    // Stop signals interrupt accept instead of ending the program, and only go to this thread
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = stopSignal;
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    printf("Serving %d sightings on %s\n", server.size, socketName);
+    fflush(stdout);
+
+    while (1) { // Each connection gets its own thread
+        client = accept(fd, NULL, NULL);
+        if (client < 0 && errno == EINTR)
+            break;
+        if (client < 0)
+            continue;
+        connection = malloc(sizeof(serverConnection));
+        connection->server = &server;
+        connection->socket = client;
+        pthread_mutex_lock(&server.connectionsLock);
+        if (server.numSockets == server.socketsCapacity) {
+            server.socketsCapacity = server.socketsCapacity ? server.socketsCapacity * 2 : 16;
+            server.sockets = realloc(server.sockets, server.socketsCapacity * sizeof(int));
+        }
+        server.sockets[server.numSockets++] = client;
+        pthread_sigmask(SIG_BLOCK, &signals, &oldSignals);
+        created = pthread_create(&thread, NULL, serveConnection, connection) == 0;
+        pthread_sigmask(SIG_SETMASK, &oldSignals, NULL);
+        if (!created) {
+            server.numSockets--;
+            close(client);
+            free(connection);
+        } else {
+            pthread_detach(thread);
+        }
+        pthread_mutex_unlock(&server.connectionsLock);
+    }
+
+    // Close every connection and wait for their threads before freeing what they use
+    printf("Stopping\n");
+    close(fd);
+    unlink(socketName);
+    pthread_mutex_lock(&server.connectionsLock);
+    for (i = 0; i < server.numSockets; i++)
+        shutdown(server.sockets[i], SHUT_RDWR);
+    while (server.numSockets > 0)
+        pthread_cond_wait(&server.connectionsDone, &server.connectionsLock);
+    pthread_mutex_unlock(&server.connectionsLock);
+    pthread_cond_destroy(&server.connectionsDone);
+    pthread_mutex_destroy(&server.connectionsLock);
+    pthread_mutex_destroy(&server.writeLock);
+    pthread_rwlock_destroy(&server.lock);
+    fclose(server.journal);
+    free(server.sockets);
+    freeView(&server.view);
+    if (server.head != NULL)
+        freeData(server.head);
+    return 1;
 }
 
-void addEntry(sightingNode **head) {
-    sightingNode *node = malloc(sizeof(sightingNode));
-    char out[500];
-    char c;
-    int i;
+double secondsNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
 
-    *out = '\0';
-    do {
-        c = ' ';
-        i = 1;
-        if (*out != '\0')
-            printf("Invalid entry\n");
-        printf("Enter a new record in the CSV form \"12/18/2004 14:30,Hanover,NH,US,circle,120,I TOTALLY SAW A CRAZY CIRCLE ORB,5/7/2024,-72.294490,43.703514\"\n> ");
-        scanf("%c", out);
-        c = out[0];
-        while (c != '\n') {
-            scanf("%c", &c);
-            if (c != '\n')
-                out[i] = c;
+long long cellKey(int latCell, int lonCell, int timeCell) {
+    // 21 bits for each, offset so negative cells fit
+    return ((long long) (latCell + (1 << 20)) & 0x1fffff) << 42 |
+           ((long long) (lonCell + (1 << 20)) & 0x1fffff) << 21 |
+           ((long long) (timeCell + (1 << 20)) & 0x1fffff);
+}
+
+double clusterDistance(clusterGrid *grid, int a, int b) {
+    sightingNode *n1 = grid->rows[a], *n2 = grid->rows[b];
+    double x = (n2->longitude - n1->longitude) * cos((n1->latitude + n2->latitude) / 2 * M_PI / 180);
+    double y = n2->latitude - n1->latitude;
+    return sqrt(x * x + y * y) * KM_PER_DEGREE;
+}
+
+int clusterRoot(atomic_int parent[], int i) {
+    int next, grandparent, expected;
+    while ((next = atomic_load(&parent[i])) != i) {
+        // Point the row at its grandparent to shorten the path for next time; if another thread changed it, skip
+        grandparent = atomic_load(&parent[next]);
+        expected = next;
+        if (grandparent != next)
+            atomic_compare_exchange_weak(&parent[i], &expected, grandparent);
+        i = next;
+    }
+    return i;
+}
+
+long dayNumber(date d) {
+    // Count from March so the leap day is the last day of the year
+    long year = d.month <= 2 ? d.year - 1 : d.year;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (d.month + (d.month > 2 ? -3 : 9)) + 2) / 5 + d.day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+int findClusters(viewIndex *view, int distance, int days, int minPoints, int labels[]) {
+    clusterGrid grid;
+    clusterWork *work;
+    pthread_t *threads;
+    long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int *clusterOf, *fill;
+    int (*pairs)[2];
+    int numClusters = 0, pass, slot, root, i;
+    sightingNode *node;
+
+    grid.rows = view->rows;
+    grid.size = view->size;
+    grid.distance = distance;
+    grid.window = (long) days * 1440;
+    grid.minPoints = minPoints;
+    grid.cellDegrees = distance / KM_PER_DEGREE / 2;
+    grid.cellMinutes = grid.window / 2;
+    grid.minutes = malloc((grid.size + 1) * sizeof(long));
+    grid.latCells = malloc((grid.size + 1) * sizeof(int));
+    grid.lonCells = malloc((grid.size + 1) * sizeof(int));
+    grid.timeCells = malloc((grid.size + 1) * sizeof(int));
+    grid.cellOf = malloc((grid.size + 1) * sizeof(int));
+    grid.points = malloc((grid.size + 1) * sizeof(int));
+    grid.core = malloc(grid.size + 1);
+    grid.border = malloc((grid.size + 1) * sizeof(int));
+    grid.parent = malloc((grid.size + 1) * sizeof(atomic_int));
+    grid.tableSize = 1;
+    while (grid.tableSize < grid.size * 2) // There can't be more cells in use than rows
+        grid.tableSize *= 2;
+    grid.keys = malloc(grid.tableSize * sizeof(long long));
+    grid.starts = malloc(grid.tableSize * sizeof(int));
+    grid.counts = calloc(grid.tableSize, sizeof(int));
+    grid.cellCore = malloc(grid.tableSize * sizeof(int));
+    for (i = 0; i < grid.tableSize; i++) {
+        grid.keys[i] = -1;
+        grid.cellCore[i] = -1;
+    }
+
+    // Count the rows in each cell, then place each row in its cell's part of points
+    for (i = 0; i < grid.size; i++) {
+        node = grid.rows[i];
+        grid.minutes[i] = dayNumber(node->dateTime.date) * 1440 + node->dateTime.hour * 60 + node->dateTime.minute;
+        grid.latCells[i] = (int) floor(node->latitude / grid.cellDegrees);
+        grid.lonCells[i] = (int) floor(node->longitude / grid.cellDegrees);
+        grid.timeCells[i] = (int) (grid.minutes[i] >= 0 ? grid.minutes[i] / grid.cellMinutes :
+                                   (grid.minutes[i] + 1) / grid.cellMinutes - 1);
+        grid.cellOf[i] = gridCell(&grid, cellKey(grid.latCells[i], grid.lonCells[i], grid.timeCells[i]), 1);
+        grid.counts[grid.cellOf[i]]++;
+        grid.border[i] = -1;
+        atomic_init(&grid.parent[i], i);
+    }
+    fill = malloc(grid.tableSize * sizeof(int));
+    for (i = 0, slot = 0; i < grid.tableSize; i++) {
+        grid.starts[i] = slot;
+        fill[i] = slot;
+        slot += grid.counts[i];
+    }
+    for (i = 0; i < grid.size; i++)
+        grid.points[fill[grid.cellOf[i]]++] = i;
+    free(fill);
+
+    // Find the core rows, then join them; each pass needs the last one done, and splits the rows between threads
+    if (numThreads > grid.size / CLUSTER_MIN_ROWS_PER_THREAD)
+        numThreads = grid.size / CLUSTER_MIN_ROWS_PER_THREAD;
+    if (numThreads < 1)
+        numThreads = 1;
+    work = malloc(numThreads * sizeof(clusterWork));
+    threads = malloc(numThreads * sizeof(pthread_t));
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < numThreads; i++) {
+            work[i].grid = &grid;
+            work[i].start = (int) (grid.size * i / numThreads);
+            work[i].end = (int) (grid.size * (i + 1) / numThreads);
+            work[i].pass = pass;
+            if (numThreads > 1)
+                pthread_create(&threads[i], NULL, clusterThread, &work[i]);
             else
-                out[i] = '\0';
-            i++;
+                clusterThread(&work[i]);
         }
-    } while (sscanf(out, "%d/%d/%d %02d:%02d,%69[^,],%2[^,],%2[^,],%9[^,],%d,%235[^,],%d/%d/%d,%lf,%lf",
-                    &node->dateTime.date.month,
-                    &node->dateTime.date.day,
-                    &node->dateTime.date.year,
-                    &node->dateTime.hour,
-                    &node->dateTime.minute,
-                    node->city,
-                    node->state,
-                    node->country,
-                    node->shape,
-                    &node->duration,
-                    node->comment,
-                    &node->dateReported.month,
-                    &node->dateReported.day,
-                    &node->dateReported.year,
-                    &node->longitude,
-                    &node->latitude
-    ) != 16);
+        for (i = 0; i < numThreads && numThreads > 1; i++)
+            pthread_join(threads[i], NULL);
+        for (i = 0; i < grid.size && pass == 0; i++) // Core rows in the same cell all join the first one
+            if (grid.core[i] && grid.cellCore[grid.cellOf[i]] < 0)
+                grid.cellCore[grid.cellOf[i]] = i;
+    }
+    free(work);
+    free(threads);
 
-    node->next = *head;
-    *head = node;
+    // Number the clusters by their roots, then renumber them from largest to smallest
+    clusterOf = malloc((grid.size + 1) * sizeof(int));
+    pairs = malloc((grid.size + 1) * sizeof(*pairs));
+    for (i = 0; i < grid.size; i++)
+        clusterOf[i] = -1;
+    for (i = 0; i < grid.size; i++) {
+        if (grid.core[i])
+            root = clusterRoot(grid.parent, i);
+        else
+            root = grid.border[i] >= 0 ? clusterRoot(grid.parent, grid.border[i]) : -1;
+        if (root < 0) {
+            labels[i] = -1;
+            continue;
+        }
+        if (clusterOf[root] < 0) {
+            clusterOf[root] = numClusters;
+            pairs[numClusters][0] = 0;
+            pairs[numClusters][1] = numClusters;
+            numClusters++;
+        }
+        labels[i] = clusterOf[root];
+        pairs[labels[i]][0]++;
+    }
+    qsort(pairs, numClusters, sizeof(*pairs), countCompare);
+    for (i = 0; i < numClusters; i++)
+        clusterOf[pairs[i][1]] = i + 1; // Reused to map each cluster to its rank
+    for (i = 0; i < grid.size; i++)
+        labels[i] = labels[i] < 0 ? 0 : clusterOf[labels[i]];
+
+    free(clusterOf);
+    free(pairs);
+    free(grid.minutes);
+    free(grid.latCells);
+    free(grid.lonCells);
+    free(grid.timeCells);
+    free(grid.cellOf);
+    free(grid.cellCore);
+    free(grid.points);
+    free(grid.core);
+    free(grid.border);
+    free(grid.parent);
+    free(grid.keys);
+    free(grid.starts);
+    free(grid.counts);
+    return numClusters;
 }
 
-void freeData(sightingNode *head) {
-    if (head->next == NULL)
-        free(head); // If this is the last node, free it
-    else
-        freeData(head->next); // Recursively free the subsequent nodes
+int gridCell(clusterGrid *grid, long long key, int add) {
+    int slot = (int) ((unsigned long long) key * 0x9E3779B97F4A7C15ULL >> 32) & (grid->tableSize - 1);
+    while (grid->keys[slot] != key) {
+        if (grid->keys[slot] == -1) {
+            if (!add)
+                return -1;
+            grid->keys[slot] = key;
+            return slot;
+        }
+        slot = (slot + 1) & (grid->tableSize - 1);
+    }
+    return slot;
 }
 
-void getDateInput(date *output, date defaultDate) {
-    char out[50];
-    char c;
+long arrowField(flatBuilder *builder, char name[], int typeType, long type, int dictionary) {
+    long nameOffset = flatString(builder, name);
+    long children = flatOffsetVector(builder, NULL, 0);
+    long indexType, encoding = 0;
+
+    if (dictionary >= 0) { // Values are 32 bit ids into a dictionary batch sent before the rows
+        flatStartTable(builder);
+        flatAddScalar(builder, 0, 32, 4); // Bit width
+        flatAddScalar(builder, 1, 1, 1); // Signed
+        indexType = flatEndTable(builder);
+        flatStartTable(builder);
+        flatAddScalar(builder, 0, dictionary, 8);
+        flatAddOffset(builder, 1, indexType);
+        encoding = flatEndTable(builder);
+    }
+    flatStartTable(builder);
+    flatAddOffset(builder, 0, nameOffset);
+    flatAddScalar(builder, 1, 0, 1); // Not nullable
+    flatAddScalar(builder, 2, typeType, 1);
+    flatAddOffset(builder, 3, type);
+    if (dictionary >= 0)
+        flatAddOffset(builder, 4, encoding);
+    flatAddOffset(builder, 5, children);
+    return flatEndTable(builder);
+}
+
+long arrowRecordBatch(flatBuilder *builder, int dictionary, long long length, long long nodes[], int numNodes,
+                      long long buffers[], int numBuffers, long long bodyLength) {
+    long nodesVector = flatLongVector(builder, nodes, numNodes, 2);
+    long buffersVector = flatLongVector(builder, buffers, numBuffers, 2);
+    long batch, header;
+
+    flatStartTable(builder);
+    flatAddScalar(builder, 0, length, 8);
+    flatAddOffset(builder, 1, nodesVector);
+    flatAddOffset(builder, 2, buffersVector);
+    batch = header = flatEndTable(builder);
+    if (dictionary >= 0) {
+        flatStartTable(builder);
+        flatAddScalar(builder, 0, dictionary, 8);
+        flatAddOffset(builder, 1, batch);
+        header = flatEndTable(builder);
+    }
+    flatStartTable(builder);
+    flatAddScalar(builder, 0, 4, 2); // Metadata version 5
+    flatAddScalar(builder, 1, dictionary >= 0 ? 2 : 3, 1); // Dictionary batch or record batch
+    flatAddOffset(builder, 2, header);
+    flatAddScalar(builder, 3, bodyLength, 8);
+    return flatEndTable(builder);
+}
+
+long arrowSchema(flatBuilder *builder) {
+    char names[][MAX_MENU_OPTION] = {"city", "state", "country", "shape"};
+    long fields[10];
+    long type;
     int i;
-    *out = '\0';
-    do {
-        c = ' ';
-        i = 1;
-        if (*out != '\0') // Only on the first iteration
-            printf("Invalid date\n");
-        printf("Enter search date in the form YYYY-MM-DD\n> ");
-        scanf("%c", out);
-        if (out[0] == '\n') { // If the user returns with nothing
-            printf("Using default date");
-            *output = defaultDate;
-            return;
+
+    flatStartTable(builder);
+    flatAddScalar(builder, 0, 0, 2); // Seconds, with no time zone
+    type = flatEndTable(builder);
+    fields[0] = arrowField(builder, "occurred", 10, type, -1);
+    for (i = 0; i < 4; i++) {
+        flatStartTable(builder); // Utf8 has no settings
+        type = flatEndTable(builder);
+        fields[i + 1] = arrowField(builder, names[i], 5, type, i);
+    }
+    flatStartTable(builder);
+    flatAddScalar(builder, 0, 32, 4);
+    flatAddScalar(builder, 1, 1, 1);
+    type = flatEndTable(builder);
+    fields[5] = arrowField(builder, "duration", 2, type, -1);
+    flatStartTable(builder);
+    type = flatEndTable(builder);
+    fields[6] = arrowField(builder, "comment", 5, type, -1);
+    flatStartTable(builder);
+    flatAddScalar(builder, 0, 0, 2); // Days
+    type = flatEndTable(builder);
+    fields[7] = arrowField(builder, "reported", 8, type, -1);
+    for (i = 8; i < 10; i++) {
+        flatStartTable(builder);
+        flatAddScalar(builder, 0, 2, 2); // Double precision
+        type = flatEndTable(builder);
+        fields[i] = arrowField(builder, i == 8 ? "latitude" : "longitude", 3, type, -1);
+    }
+
+    type = flatOffsetVector(builder, fields, 10);
+    flatStartTable(builder);
+    flatAddScalar(builder, 0, 0, 2); // Little endian
+    flatAddOffset(builder, 1, type);
+    return flatEndTable(builder);
+}
+
+long arrowWriteMessage(FILE *file, flatBuilder *builder) {
+    int prefix[2] = {-1, (int) ((builder->size + 7) & ~7L)}; // Continuation marker and padded length
+    fwrite(prefix, sizeof(int), 2, file);
+    fwrite(builder->bytes + builder->capacity - builder->size, 1, builder->size, file);
+    arrowPad(file, builder->size);
+    return 8 + prefix[1];
+}
+
+int exportArrow(char fileName[], viewIndex *view) {
+    FILE *file;
+    flatBuilder builder = {NULL, 0, 0, 1, 0, {0}, 0};
+    dictionaryColumn dictionaries[4];
+    int *ids[4];
+    char **comments = malloc((view->size + 1) * sizeof(char *));
+    long long nodes[20], buffers[42], bodyLength, commentsLength = 0, value, position;
+    long long dictionaryBlocks[12], batchBlock[3];
+    long metaDataLength, schema, dictionaryVector, batchVector;
+    double coordinate;
+    sightingNode *node;
+    int numBuffers, written, i, j;
+
+    // Give each text value an id, and find the lengths every buffer will have before writing anything
+    for (j = 0; j < 4; j++) {
+        memset(&dictionaries[j], 0, sizeof(dictionaryColumn));
+        startDictionary(&dictionaries[j], view->size);
+        ids[j] = malloc((view->size + 1) * sizeof(int));
+    }
+    for (i = 0; i < view->size; i++) {
+        node = view->rows[i];
+        ids[0][i] = dictionaryId(&dictionaries[0], node->city);
+        ids[1][i] = dictionaryId(&dictionaries[1], node->state);
+        ids[2][i] = dictionaryId(&dictionaries[2], node->country);
+        ids[3][i] = dictionaryId(&dictionaries[3], node->shape);
+        comments[i] = node->comment;
+        commentsLength += (long long) strlen(node->comment);
+    }
+
+    file = fopen(fileName, "wb");
+    if (file != NULL) {
+        setvbuf(file, NULL, _IOFBF, ARROW_WRITE_BUFFER);
+        fwrite(ARROW_MAGIC "\0\0", 1, 8, file);
+        schema = arrowSchema(&builder);
+        flatStartTable(&builder);
+        flatAddScalar(&builder, 0, 4, 2);
+        flatAddScalar(&builder, 1, 1, 1); // Schema
+        flatAddOffset(&builder, 2, schema);
+        flatFinish(&builder, flatEndTable(&builder));
+        position = 8 + arrowWriteMessage(file, &builder);
+
+        // One dictionary batch for each dictionary encoded column
+        for (j = 0; j < 4; j++) {
+            builder.size = 0;
+            numBuffers = 0;
+            bodyLength = 0;
+            nodes[0] = dictionaries[j].size;
+            nodes[1] = 0;
+            for (i = 0, value = 0; i < dictionaries[j].size; i++)
+                value += (long long) strlen(dictionaries[j].values[i]);
+            arrowBuffer(buffers, &numBuffers, &bodyLength, 0); // No nulls, so no validity bitmap
+            arrowBuffer(buffers, &numBuffers, &bodyLength, (dictionaries[j].size + 1) * 4LL);
+            arrowBuffer(buffers, &numBuffers, &bodyLength, value);
+            flatFinish(&builder, arrowRecordBatch(&builder, j, dictionaries[j].size, nodes, 1, buffers, numBuffers,
+                                                  bodyLength));
+            metaDataLength = arrowWriteMessage(file, &builder);
+            arrowWriteStrings(file, dictionaries[j].values, dictionaries[j].size);
+            dictionaryBlocks[j * 3] = position;
+            dictionaryBlocks[j * 3 + 1] = metaDataLength;
+            dictionaryBlocks[j * 3 + 2] = bodyLength;
+            position += metaDataLength + bodyLength;
         }
-        while (c != '\n') { // Continue reading character by character up to the newline
-            scanf("%c", &c);
-            if (c != '\n')
-                out[i] = c;
-            else
-                out[i] = '\0';
-            i++;
+
+        // Then every row in one record batch, laid out in the order of the schema
+        builder.size = 0;
+        numBuffers = 0;
+        bodyLength = 0;
+        for (j = 0; j < 10; j++) {
+            nodes[j * 2] = view->size;
+            nodes[j * 2 + 1] = 0;
+            arrowBuffer(buffers, &numBuffers, &bodyLength, 0);
+            if (j == 6) { // Comment offsets and bytes
+                arrowBuffer(buffers, &numBuffers, &bodyLength, (view->size + 1) * 4LL);
+                arrowBuffer(buffers, &numBuffers, &bodyLength, commentsLength);
+            } else { // Timestamps and doubles take 8 bytes; ids, durations, and dates 4
+                arrowBuffer(buffers, &numBuffers, &bodyLength, view->size * (j == 0 || j >= 8 ? 8LL : 4LL));
+            }
         }
-        printf("\nSTRING: %s\n", out);
-        // Try to parse the string. If it cannot be parsed, the data was invalid, so repeat and tell the user that.
-    } while (sscanf(out, "%d-%d-%d", &output->year, &output->month, &output->day) != 3);
+        flatFinish(&builder, arrowRecordBatch(&builder, -1, view->size, nodes, 10, buffers, numBuffers, bodyLength));
+        metaDataLength = arrowWriteMessage(file, &builder);
+        batchBlock[0] = position;
+        batchBlock[1] = metaDataLength;
+        batchBlock[2] = bodyLength;
+
+        for (i = 0; i < view->size; i++) {
+            node = view->rows[i];
+            value = (dayNumber(node->dateTime.date) * 1440 + node->dateTime.hour * 60 + node->dateTime.minute) * 60;
+            fwrite(&value, sizeof(value), 1, file);
+        }
+        for (j = 0; j < 4; j++) {
+            fwrite(ids[j], sizeof(int), view->size, file);
+            arrowPad(file, view->size * 4LL);
+        }
+        for (i = 0; i < view->size; i++)
+            fwrite(&view->rows[i]->duration, sizeof(int), 1, file);
+        arrowPad(file, view->size * 4LL);
+        arrowWriteStrings(file, comments, view->size);
+        for (i = 0; i < view->size; i++) {
+            written = (int) dayNumber(view->rows[i]->dateReported);
+            fwrite(&written, sizeof(int), 1, file);
+        }
+        arrowPad(file, view->size * 4LL);
+        for (i = 0; i < view->size; i++) {
+            coordinate = view->rows[i]->latitude;
+            fwrite(&coordinate, sizeof(double), 1, file);
+        }
+        for (i = 0; i < view->size; i++) {
+            coordinate = view->rows[i]->longitude;
+            fwrite(&coordinate, sizeof(double), 1, file);
+        }
+
+        // End of stream marker, then the footer that lets readers find every batch
+        nodes[0] = -1;
+        nodes[1] = 0;
+        fwrite(nodes, sizeof(int), 1, file);
+        fwrite(&nodes[1], sizeof(int), 1, file);
+        builder.size = 0;
+        schema = arrowSchema(&builder);
+        dictionaryVector = flatLongVector(&builder, dictionaryBlocks, 4, 3);
+        batchVector = flatLongVector(&builder, batchBlock, 1, 3);
+        flatStartTable(&builder);
+        flatAddScalar(&builder, 0, 4, 2);
+        flatAddOffset(&builder, 1, schema);
+        flatAddOffset(&builder, 2, dictionaryVector);
+        flatAddOffset(&builder, 3, batchVector);
+        flatFinish(&builder, flatEndTable(&builder));
+        fwrite(builder.bytes + builder.capacity - builder.size, 1, builder.size, file);
+        written = (int) builder.size;
+        fwrite(&written, sizeof(int), 1, file);
+        fwrite(ARROW_MAGIC, 1, strlen(ARROW_MAGIC), file);
+        written = !ferror(file);
+        written = fclose(file) == 0 && written;
+    } else {
+        written = 0;
+    }
+
+    for (j = 0; j < 4; j++) {
+        freeDictionary(&dictionaries[j]);
+        free(ids[j]);
+    }
+    free(comments);
+    free(builder.bytes);
+    return written;
+}
+
+long flatEndTable(flatBuilder *builder) {
+    long table, vtable;
+    int i;
+
+    flatPrep(builder, 4, 0);
+    flatPushScalar(builder, 0, 4); // Filled in with the distance back to the vtable below
+    table = builder->size;
+    // The vtable gives where each field is from the start of the table, or 0 if it is not set
+    for (i = builder->numFields - 1; i >= 0; i--)
+        flatPushScalar(builder, builder->fields[i] ? table - builder->fields[i] : 0, 2);
+    flatPushScalar(builder, table - builder->tableStart, 2);
+    flatPushScalar(builder, (builder->numFields + 2) * 2, 2);
+    vtable = builder->size - table; // Distance back from the table to its vtable
+    for (i = 0; i < 4; i++)
+        builder->bytes[builder->capacity - table + i] = (unsigned char) (vtable >> (8 * i));
+    return table;
+}
+
+long flatLongVector(flatBuilder *builder, long long values[], int count, int width) {
+    int i;
+    flatPrep(builder, 4, count * width * 8L);
+    flatPrep(builder, 8, count * width * 8L);
+    for (i = count * width - 1; i >= 0; i--)
+        flatPushScalar(builder, values[i], 8);
+    flatPushScalar(builder, count, 4);
+    return builder->size;
+}
+
+long flatOffsetVector(flatBuilder *builder, long offsets[], int count) {
+    int i;
+    flatPrep(builder, 4, count * 4L);
+    for (i = count - 1; i >= 0; i--)
+        flatPushScalar(builder, builder->size + 4 - offsets[i], 4);
+    flatPushScalar(builder, count, 4);
+    return builder->size;
+}
+
+long flatString(flatBuilder *builder, char string[]) {
+    long length = (long) strlen(string);
+    flatPrep(builder, 4, length + 1);
+    flatPush(builder, "", 1);
+    flatPush(builder, string, length);
+    flatPushScalar(builder, length, 4);
+    return builder->size;
+}
+
+int copyField(char *start, char *end, char string[], int max) {
+    char *c;
+    int i = 0;
+
+    string[0] = '\0';
+    if (start < end && *start == '"') { // Quoted, so the closing quote must come right before the comma
+        if (end - start < 2 || end[-1] != '"')
+            return 0;
+        for (c = start + 1; c < end - 1; c++) {
+            if (*c == '"' && (c + 1 == end - 1 || *++c != '"')) // Quotes inside must be doubled
+                return 0;
+            if (i < max - 1)
+                string[i++] = *c;
+        }
+    } else {
+        if (memchr(start, '"', end - start) != NULL) // Quotes can only go around a whole field
+            return 0;
+        i = (int) (end - start < max - 1 ? end - start : max - 1);
+        memcpy(string, start, i);
+    }
+    string[i] = '\0';
+    return 1;
+}
+
+int convertRow(char buffer[], int start, int ends[], int count, sightingNode *node, char error[]) {
+    char *strings[CSV_FIELDS] = {NULL, node->city, node->state, node->country, node->shape, NULL, node->comment};
+    int sizes[CSV_FIELDS] = {0, MAX_CITY, sizeof(node->state), sizeof(node->country), MAX_SHAPE, 0, MAX_COMMENT};
+    int starts[CSV_FIELDS], stops[CSV_FIELDS];
+    char text[MAX_LINE];
+    int values[5];
+    int fields = 0;
+    int used, i;
+
+    // Split the row at its field ends; a comma ends a field and anything else ends the row
+    for (used = 0; used < count; used++) {
+        if (ends[used] < 0) // A line break inside a quoted field
+            continue;
+        if (fields < CSV_FIELDS) {
+            starts[fields] = fields == 0 ? start : stops[fields - 1] + 1;
+            stops[fields] = ends[used];
+        }
+        fields++;
+        if (buffer[ends[used]] != ',')
+            break;
+    }
+    if (used == count)
+        return 0;
+    used++;
+    error[0] = '\0';
+    if (fields != CSV_FIELDS) {
+        sprintf(error, "%d fields instead of %d", fields, CSV_FIELDS);
+        return used;
+    }
+    if (stops[CSV_FIELDS - 1] > starts[CSV_FIELDS - 1] && buffer[stops[CSV_FIELDS - 1] - 1] == '\r')
+        stops[CSV_FIELDS - 1]--; // Windows line ending
+
+    for (i = 0; i < CSV_FIELDS; i++) {
+        if (!copyField(buffer + starts[i], buffer + stops[i], strings[i] ? strings[i] : text,
+                       strings[i] ? sizes[i] : (int) sizeof(text))) {
+            sprintf(error, "field %d has a quote out of place", i + 1);
+            return used;
+        }
+        if (i == 0) {
+            if (!readNumbers(text, "// :", values)) {
+                sprintf(error, "the date and time \"%.20s\" is not M/D/YYYY H:MM", text);
+                return used;
+            }
+            node->dateTime.date.month = values[0];
+            node->dateTime.date.day = values[1];
+            node->dateTime.date.year = values[2];
+            node->dateTime.hour = values[3];
+            node->dateTime.minute = values[4];
+        } else if (i == 5) {
+            node->duration = atoi(text);
+        } else if (i == 7) {
+            if (!readNumbers(text, "//", values)) {
+                sprintf(error, "the date reported \"%.20s\" is not M/D/YYYY", text);
+                return used;
+            }
+            node->dateReported.month = values[0];
+            node->dateReported.day = values[1];
+            node->dateReported.year = values[2];
+        } else if (i == 8) {
+            node->latitude = atof(text); // The data has latitude first
+        } else if (i == 9) {
+            node->longitude = atof(text);
+        }
+    }
+    node->id = 0;
+    node->next = NULL;
+    return used;
+}
+
+int readNumbers(char text[], char separators[], int values[]) {
+    char *c = text;
+    int count = (int) strlen(separators) + 1;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (i > 0 && *c++ != separators[i - 1])
+            return 0;
+        if (*c < '0' || *c > '9')
+            return 0;
+        for (values[i] = 0; *c >= '0' && *c <= '9'; c++)
+            values[i] = values[i] * 10 + *c - '0';
+    }
+    return 1;
+}
+
+int readRecord(FILE *file, char **line, int *capacity, int *open) {
+    int length = 0, quotes = 0;
+    char *c;
+
+    if (*capacity < MAX_LINE) {
+        *capacity = MAX_LINE;
+        *line = realloc(*line, *capacity);
+    }
+    // Keep reading while the line didn't fit or a quoted field is still open
+    while (fgets(*line + length, *capacity - length, file) != NULL) {
+        for (c = *line + length; *c != '\0'; c++)
+            quotes += *c == '"';
+        length = (int) (c - *line);
+        if (length > 0 && (*line)[length - 1] == '\n' && quotes % 2 == 0)
+            break;
+        if (*capacity - length < MAX_LINE) { // Double the buffer when it is nearly full
+            *capacity *= 2;
+            *line = realloc(*line, *capacity);
+        }
+    }
+    *open = quotes % 2;
+    return length;
+}
+
+int scanStructure(char buffer[], int length, int ends[], int max) {
+    char last[64];
+    unsigned long long state = 0, mask, breaks;
+    int count = 0;
+    int i;
+
+    for (i = 0; i < length && count < max; i += 64) {
+        if (length - i >= 64) {
+            mask = scanBlock(buffer + i, &state, &breaks);
+        } else { // Pad the last block with bytes that end nothing
+            memset(last, 0, sizeof(last));
+            memcpy(last, buffer + i, length - i);
+            mask = scanBlock(last, &state, &breaks);
+        }
+        mask |= breaks;
+        while (mask != 0 && count < max) { // Each set bit, lowest first
+            ends[count] = i + __builtin_ctzll(mask);
+            if (breaks & (mask & -mask))
+                ends[count] = ~ends[count];
+            count++;
+            mask &= mask - 1;
+        }
+    }
+    return count;
+}
+
+unsigned long long scanBlock(const char block[], unsigned long long *quoted, unsigned long long *breaks) {
+    unsigned long long commas = 0, quotes = 0, newlines = 0, inside;
+    int i;
+#ifdef __SSE2__
+    __m128i bytes;
+    for (i = 0; i < 64; i += 16) { // Compare 16 bytes at once, giving a mask with a bit for each
+        bytes = _mm_loadu_si128((const __m128i *) (block + i));
+        commas |= (unsigned long long) (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(','))) << i;
+        quotes |= (unsigned long long) (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))) << i;
+        newlines |= (unsigned long long) (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))) << i;
+    }
+#else
+    for (i = 0; i < 64; i++) {
+        commas |= (unsigned long long) (block[i] == ',') << i;
+        quotes |= (unsigned long long) (block[i] == '"') << i;
+        newlines |= (unsigned long long) (block[i] == '\n') << i;
+    }
+#endif
+    // A byte is inside quotes if an odd number of quotes come before it, counting itself. Each bit becomes the xor of
+    // itself and every bit below it. Doubled quotes in a quoted field flip the state twice, so they stay inside.
+    inside = quotes;
+    inside ^= inside << 1;
+    inside ^= inside << 2;
+    inside ^= inside << 4;
+    inside ^= inside << 8;
+    inside ^= inside << 16;
+    inside ^= inside << 32;
+    inside ^= *quoted;
+    *quoted = inside >> 63 ? ~0ULL : 0;
+    *breaks = newlines & inside;
+    return (commas | newlines) & ~inside;
+}
+
+int checkColumns(columnStore *store) {
+    unsigned char *cursor = store->comments.bytes;
+    unsigned char *end = store->comments.bytes + store->comments.size;
+    long long rawSize, compressedSize;
+    int row;
+
+    if (!checkVarints(&store->occurred, store->size) || !checkVarints(&store->reported, store->size) ||
+        !checkVarints(&store->durations, store->size) || !checkVarints(&store->coordinates, store->size * 2L))
+        return 0;
+    for (row = 0; row < store->size; row += COMMENT_BLOCK_ROWS) {
+        if (cursor >= end)
+            return 0;
+        rawSize = getVarint(&cursor);
+        compressedSize = getVarint(&cursor);
+        if (cursor > end || rawSize < 0 || rawSize > COMMENT_BLOCK_ROWS * MAX_COMMENT || compressedSize < 0 ||
+            compressedSize > end - cursor)
+            return 0;
+        cursor += compressedSize;
+    }
+    return 1;
+}
+
+int checkVarints(byteBuffer *section, long count) {
+    unsigned char *cursor = section->bytes;
+    unsigned char *end = section->bytes + section->size;
+    long i;
+    // getBuffer leaves zeros past the end, so a varint cut off there still stops
+    for (i = 0; i < count; i++) {
+        if (cursor >= end)
+            return 0;
+        getVarint(&cursor);
+    }
+    return cursor <= end;
+}
+
+int lzDecompress(unsigned char input[], int inputSize, unsigned char output[], int size) {
+    unsigned char *end = input + inputSize;
+    int position = 0, count, distance;
+    while (input < end) {
+        count = (int) getVarint(&input);
+        if (count < 0 || count > size - position || count > end - input)
+            break;
+        memcpy(output + position, input, count);
+        input += count;
+        position += count;
+        if (position >= size || input >= end)
+            break;
+        count = (int) getVarint(&input);
+        distance = (int) getVarint(&input);
+        if (input > end || count < 0 || count > size - position || distance < 1 || distance > position)
+            break;
+        for (; count > 0; count--, position++) // Byte by byte, since the repeat may overlap itself
+            output[position] = output[position - distance];
+    }
+    return position;
+}
+
+int readColumns(columnStore *store, columnCursor *cursor, sightingNode *node) {
+    long long value;
+    long rawSize, compressedSize;
+    int i, blockRows;
+
+    cursor->prevOccurred += getVarint(&cursor->occurred);
+    value = cursor->prevOccurred / TIME_SLOTS;
+    node->dateTime.hour = (int) (cursor->prevOccurred % TIME_SLOTS / 60);
+    node->dateTime.minute = (int) (cursor->prevOccurred % 60);
+    node->dateTime.date.day = (int) (value % 31 + 1);
+    node->dateTime.date.month = (int) (value / 31 % 12 + 1);
+    node->dateTime.date.year = (int) (value / 31 / 12);
+    cursor->prevReported += getVarint(&cursor->reported);
+    node->dateReported.day = (int) (cursor->prevReported % 31 + 1);
+    node->dateReported.month = (int) (cursor->prevReported / 31 % 12 + 1);
+    node->dateReported.year = (int) (cursor->prevReported / 31 / 12);
+    node->duration = (int) getVarint(&cursor->durations);
+    node->longitude = (double) getVarint(&cursor->coordinates) / 1e7;
+    node->latitude = (double) getVarint(&cursor->coordinates) / 1e7;
+    strcpy(node->city, store->cities.values[unpackId(&store->cities, cursor->row)]);
+    strcpy(node->state, store->states.values[unpackId(&store->states, cursor->row)]);
+    strcpy(node->country, store->countries.values[unpackId(&store->countries, cursor->row)]);
+    strcpy(node->shape, store->shapes.values[unpackId(&store->shapes, cursor->row)]);
+
+    if (cursor->blockRows == 0) { // Start the next block, only decompressing it if one of its rows is wanted
+        rawSize = (long) getVarint(&cursor->comments);
+        compressedSize = (long) getVarint(&cursor->comments);
+        blockRows = store->size - cursor->row < COMMENT_BLOCK_ROWS ? store->size - cursor->row : COMMENT_BLOCK_ROWS;
+        cursor->comment = NULL;
+        for (i = 0; i < blockRows && cursor->comment == NULL; i++)
+            if (cursor->wanted == NULL || cursor->wanted[cursor->row + i])
+                cursor->comment = cursor->block;
+        // checkColumns made sure the sizes fit, but the compressed bytes still have to give all of the block
+        if (cursor->comment != NULL && lzDecompress(cursor->comments, (int) compressedSize,
+                                                    (unsigned char *) cursor->block, (int) rawSize) != rawSize)
+            return 0;
+        cursor->block[rawSize] = '\0';
+        cursor->blockEnd = cursor->block + rawSize;
+        cursor->comments += compressedSize;
+        cursor->blockRows = blockRows;
+    }
+    if (cursor->comment != NULL) {
+        if (cursor->comment >= cursor->blockEnd || strlen(cursor->comment) >= MAX_COMMENT)
+            return 0;
+        strcpy(node->comment, cursor->comment);
+        cursor->comment += strlen(cursor->comment) + 1;
+    } else {
+        node->comment[0] = '\0';
+    }
+    cursor->blockRows--;
+    cursor->row++;
+    node->next = NULL;
+    return 1;
 }
 
-void getFileName(char fileName[]) {
-    int incomplete = 1;
+int compactData(char fileName[], sightingNode *head, FILE **journal, long *offset) {
+    char tempName[100];
     FILE *file;
-    char _;
-    while (incomplete) {
-        printf("Enter file name\n> ");
-        scanf("%s", fileName);
-        file = fopen(fileName, "r");
-        if (file != NULL) { // If the file exists, nothing else to do in this function
-            incomplete = 0;
-            fclose(file);
-            scanf("%c", &_); // Clear the buffer
-        } else { // If not, tell the user that
-            printf("That file does not exist\n");
-        }
+    sightingNode *node = head;
+
+    // Write to a separate file first so the old file and journal are still there if anything goes wrong
+    snprintf(tempName, sizeof(tempName), "%s.tmp", fileName);
+    file = fopen(tempName, "w");
+    if (file == NULL) {
+        printf("Could not write to %s. Compaction cancelled\n", tempName);
+        return 0;
+    }
+    saveList(file, node);
+    *offset = ftell(file);
+    fflush(file);
+    fsync(fileno(file));
+    fclose(file);
+    if (rename(tempName, fileName) != 0) {
+        printf("Could not replace %s. Compaction cancelled\n", fileName);
+        remove(tempName);
+        return 0;
     }
+
+    // Everything in the journal is in the file now, so start a new one
+    snprintf(tempName, sizeof(tempName), "%s%s", fileName, JOURNAL_EXTENSION);
+    if (*journal != NULL)
+        fclose(*journal);
+    *journal = fopen(tempName, "w");
+    if (*journal == NULL) { // The old entries must not be replayed onto the new file
+        remove(tempName);
+        printf("Could not start a new journal %s, so changes will only be kept by saving\n", tempName);
+    } else {
+        fsync(fileno(*journal));
+    }
+    printf("Changes compacted into %s.\n", fileName);
+    return 1;
 }
 
-void getStringInput(char output[], char defaultString[]) {
-    char out[50];
-    char c = ' ';
-    int i = 1;
-    printf("Enter search term\n> ");
-    scanf("%c", out);
-    if (out[0] == '\n') {
-        printf("Using default term %s\n", defaultString);
-        strcpy(output, defaultString);
-        return;
+int cityId(cityIndex *index, char city[], int add) {
+    int slot = (int) (hashString(FNV_OFFSET, city) & (index->tableSize - 1));
+    int id, length, i, t, *posting;
+
+    while (index->table[slot] != -1) {
+        if (strcmp(index->names[index->table[slot]], city) == 0)
+            return index->table[slot];
+        slot = (slot + 1) & (index->tableSize - 1);
     }
-    while (c != '\n') { // Read character by character until the whole string is read
-        scanf("%c", &c);
-        if (c != '\n')
-            out[i] = c;
-        else
-            out[i] = '\0';
-        i++;
+    if (!add)
+        return -1;
+
+    id = index->size++;
+    index->table[slot] = id;
+    strcpy(index->names[id], city);
+    length = normalizeCity(city, index->normalized[id]);
+    // Ids only increase, so adding to the end keeps every posting list in order
+    for (i = 0; i + 3 <= length; i++) {
+        t = trigram(index->normalized[id] + i);
+        posting = index->postings[t];
+        if (index->postingSizes[t] > 0 && posting[index->postingSizes[t] - 1] == id) // Repeated trigram
+            continue;
+        if (index->postingSizes[t] == index->postingCapacities[t]) {
+            index->postingCapacities[t] = index->postingCapacities[t] ? index->postingCapacities[t] * 2 : 4;
+            index->postings[t] = realloc(posting, index->postingCapacities[t] * sizeof(int));
+        }
+        index->postings[t][index->postingSizes[t]++] = id;
     }
-    strcpy(output, out);
+    return id;
 }
 
-void lookAhead(sightingNode **node, int steps) {
+int contains(char c, char arr[], int len) {
     int i;
-    sightingNode *out = *node;
-    for (i = 0; i < steps; i++) {
-        if (out->next) // If the next node is not NULL
-            out = out->next;
-        else // If it is NULL, don't go ahead anymore
-            return;
+    for (i = 0; i < len; i++)
+        if (arr[i] == c)
+            return 1;
+    return 0;
+}
+
+int editDistance(char s1[], char s2[]) {
+    int len2 = (int) strlen(s2);
+    int row[MAX_CITY + 1]; // Only one row of the table is needed at a time
+    int i, j, diagonal, above;
+
+    for (j = 0; j <= len2; j++)
+        row[j] = j;
+    for (i = 1; s1[i - 1] != '\0'; i++) {
+        diagonal = row[0];
+        row[0] = i;
+        for (j = 1; j <= len2; j++) {
+            above = row[j];
+            row[j] = diagonal + (s1[i - 1] != s2[j - 1]); // Substitute
+            if (above + 1 < row[j]) // Delete
+                row[j] = above + 1;
+            if (row[j - 1] + 1 < row[j]) // Insert
+                row[j] = row[j - 1] + 1;
+            diagonal = above;
+        }
     }
-    *node = out; // Replace the node pointer with the new one
+    return row[len2];
 }
 
-void printArray(sightingNode *arr[], int size) {
-    int i = 0;
-    while (arr[i] != NULL && i < size) {
-        printf("(%d) ", i);
-        printNode(arr[i]);
-        printf("\n");
-        i++;
+int externalSort(char inName[], char outName[], int dir, compare function, long memoryLimit) {
+    FILE *input = fopen(inName, "r");
+    FILE *output;
+    FILE **runs = NULL;
+    FILE *merged;
+    long rowsPerRun = memoryLimit / (long) (sizeof(sightingNode) + 2 * sizeof(sightingNode *));
+    long written;
+    sightingNode *nodes;
+    sightingNode **rows, **buffer;
+    int numRuns = 0, runCapacity = 0;
+    csvPosition position = {inName, 1, 0};
+    int count, result, i;
+    int failed = 0;
+
+    if (input == NULL) {
+        printf("There is no file called %s\n", inName);
+        return 0;
+    }
+    if (rowsPerRun < 1)
+        rowsPerRun = 1;
+    nodes = malloc(rowsPerRun * sizeof(sightingNode));
+    rows = malloc(rowsPerRun * sizeof(sightingNode *));
+    buffer = malloc(rowsPerRun * sizeof(sightingNode *));
+
+    // Read, sort, and spill one run at a time, each as big as the memory limit allows
+    do {
+        count = 0;
+        while (count < rowsPerRun && (result = readNode(input, &nodes[count], 0, &position)) != 0) {
+            if (result == 1) {
+                rows[count] = &nodes[count];
+                count++;
+            }
+        }
+        if (count == 0)
+            break;
+        mergeSort(rows, buffer, count, dir, function);
+        if (numRuns == runCapacity) {
+            runCapacity = runCapacity ? runCapacity * 2 : 16;
+            runs = realloc(runs, runCapacity * sizeof(FILE *));
+        }
+        runs[numRuns] = tmpfile();
+        if (runs[numRuns] == NULL) {
+            printf("Could not create a temporary file. Sort cancelled\n");
+            failed = 1;
+            break;
+        }
+        for (i = 0; i < count; i++) {
+            saveNode(runs[numRuns], rows[i]);
+            fprintf(runs[numRuns], "\n");
+        }
+        rewind(runs[numRuns]);
+        numRuns++;
+        if (numRuns == MAX_MERGE_WAYS) { // Fold the runs so far into one, which still comes before any later run
+            merged = tmpfile();
+            if (merged == NULL) {
+                printf("Could not create a temporary file. Sort cancelled\n");
+                failed = 1;
+                break;
+            }
+            mergeRuns(runs, NULL, numRuns, merged, dir, function);
+            for (i = 0; i < numRuns; i++)
+                fclose(runs[i]);
+            rewind(merged);
+            runs[0] = merged;
+            numRuns = 1;
+        }
+    } while (count == rowsPerRun);
+    fclose(input);
+    free(nodes);
+    free(rows);
+    free(buffer);
+    if (failed) {
+        for (i = 0; i < numRuns; i++)
+            fclose(runs[i]);
+        free(runs);
+        return 0;
+    }
+
+    output = fopen(outName, "w");
+    if (output == NULL) {
+        printf("Could not write to %s\n", outName);
+        written = -1;
+    } else {
+        written = mergeRuns(runs, NULL, numRuns, output, dir, function);
+        fclose(output);
+        printf("Sorted %ld sightings into %s\n", written, outName);
+    }
+    for (i = 0; i < numRuns; i++)
+        fclose(runs[i]);
+    free(runs);
+    if (position.errors > 0) // The output is still written, but without the rows that could not be read
+        printf("Left out %d rows of %s that could not be read\n", position.errors, inName);
+    return written >= 0 && position.errors == 0;
+}
+
+int dedupData(sightingNode **head, int remove, FILE *journal) {
+    viewIndex rows = {NULL, 0, 0};
+    unsigned long long *keys, *comments, difference;
+    int *table, *groupNext, *original;
+    int tableSize = 1;
+    int duplicates = 0;
+    int i, j, slot, distance;
+    sightingNode **link = head;
+    sightingNode *temp;
+
+    buildView(&rows, *head);
+    while (tableSize < rows.size * 2) // Keep the table at most half full
+        tableSize *= 2;
+    table = malloc(tableSize * sizeof(int));
+    keys = malloc(rows.size * sizeof(unsigned long long));
+    comments = malloc(rows.size * sizeof(unsigned long long));
+    groupNext = malloc(rows.size * sizeof(int)); // Next row with the same key, forming a chain per key
+    original = malloc(rows.size * sizeof(int)); // Row each row is a duplicate of, or -1
+    for (i = 0; i < tableSize; i++)
+        table[i] = -1;
+
+    for (i = 0; i < rows.size; i++) {
+        keys[i] = dedupKey(rows.rows[i]);
+        comments[i] = simHash(rows.rows[i]->comment);
+        groupNext[i] = -1;
+        original[i] = -1;
+        // Find the chain of rows with the same key, using linear probing
+        slot = (int) (keys[i] & (tableSize - 1));
+        while (table[slot] != -1 && (keys[table[slot]] != keys[i] ||
+                                     dateTimeCompare(rows.rows[table[slot]], rows.rows[i], 1) != 0 ||
+                                     strcmp(rows.rows[table[slot]]->city, rows.rows[i]->city) != 0 ||
+                                     strcmp(rows.rows[table[slot]]->state, rows.rows[i]->state) != 0 ||
+                                     strcmp(rows.rows[table[slot]]->shape, rows.rows[i]->shape) != 0))
+            slot = (slot + 1) & (tableSize - 1);
+        if (table[slot] == -1) { // First row with this key
+            table[slot] = i;
+            continue;
+        }
+        // Compare the comment with the earlier rows that have the same key, which are usually very few
+        for (j = table[slot];; j = groupNext[j]) {
+            if (original[i] == -1 && original[j] == -1) {
+                distance = 0;
+                for (difference = comments[i] ^ comments[j]; difference; difference &= difference - 1)
+                    distance++;
+                if (distance <= DEDUP_MAX_DISTANCE) {
+                    original[i] = j;
+                    duplicates++;
+                }
+            }
+            if (groupNext[j] == -1)
+                break;
+        }
+        groupNext[j] = i;
+    }
+
+    if (!remove) { // Print each kept row followed by its duplicates
+        for (i = 0; i < rows.size; i++) {
+            if (original[i] != -1)
+                continue;
+            for (j = groupNext[i]; j != -1; j = groupNext[j]) {
+                if (original[j] != i)
+                    continue;
+                if (rows.rows[i] != NULL) {
+                    printf(SPACER);
+                    printNode(rows.rows[i]);
+                    printf("\n");
+                    rows.rows[i] = NULL; // Only print the kept row once
+                }
+                printf("  duplicate: ");
+                printNode(rows.rows[j]);
+                printf("\n");
+            }
+        }
+    } else { // Rows are in list order, so remove them in a single pass over the list
+        for (i = 0; i < rows.size; i++) {
+            if (original[i] == -1) {
+                link = &(*link)->next;
+                continue;
+            }
+            temp = *link;
+            *link = temp->next;
+            if (journal != NULL)
+                journalEntry(journal, '-', temp);
+            free(temp);
+        }
     }
+
+    free(table);
+    free(keys);
+    free(comments);
+    free(groupNext);
+    free(original);
+    freeView(&rows);
+    return duplicates;
 }
 
-void printList(sightingNode *head, int maxNodes) {
+int loadData(char fileName[], sightingNode *head, long *offset, int requireNewline) {
+    FILE *csv = fopen(fileName, "r");
+    int capacity = CSV_CHUNK;
+    char *buffer = malloc(capacity + 1);
+    int *ends = malloc((capacity + 1) * sizeof(int));
+    char error[MAX_LINE];
     sightingNode *node = head;
+    sightingNode read;
+    long line = 1; // Line of the file the next row starts on
+    long consumed = 0; // Bytes of the file before the buffer
+    int length = 0;
+    int atEnd = 0;
+    int errors = 0;
     int i = 0;
-    while (node != NULL && i < maxNodes) {
-        printf("(%d) ", i);
-        printNode(node);
-        printf("\n");
-        i++;
-        node = node->next;
+    char *end;
+    int count, start, used, breaks, j, k;
+
+    head->next = NULL;
+    // Read the file in large chunks. Stage one finds the field ends in the whole chunk, then stage two converts each
+    // complete row; a row cut off by the end of the chunk is moved to the front and finished with the next chunk.
+    while (!atEnd || length > 0) {
+        length += (int) fread(buffer + length, 1, capacity - length, csv);
+        atEnd = length < capacity;
+        buffer[length] = '\0';
+        count = scanStructure(buffer, length, ends, capacity);
+        if (atEnd && !requireNewline) // The last row may not end with a line break
+            ends[count++] = length;
+
+        start = 0;
+        for (k = 0; k < count && start < length; k += used) {
+            if (ends[k] >= 0 && buffer[ends[k]] == '\n' &&
+                (ends[k] == start || (ends[k] == start + 1 && buffer[start] == '\r'))) { // Blank lines are not rows
+                used = 1;
+                line++;
+                start = ends[k] + 1;
+                continue;
+            }
+            used = convertRow(buffer, start, ends + k, count - k, &read, error);
+            if (used == 0)
+                break;
+            for (breaks = 0, j = k; j < k + used; j++)
+                if (ends[j] < 0)
+                    breaks++;
+            if (error[0] != '\0') { // Report the line and skip the row
+                if (errors++ < CSV_MAX_ERRORS)
+                    printf("%s line %ld: %s\n", fileName, line, error);
+                if (breaks > 0) { // A stray quote may have taken in the lines after it, so skip one line and scan again
+                    end = memchr(buffer + start, '\n', length - start);
+                    start = end != NULL ? (int) (end - buffer) + 1 : length;
+                    line++;
+                    break;
+                }
+            } else {
+                if (i > 0) { // The head node is already allocated; every other node needs memory
+                    node->next = malloc(sizeof(sightingNode));
+                    node = node->next;
+                }
+                *node = read;
+                i++;
+            }
+            line += breaks + 1;
+            start = ends[k + used - 1] + 1;
+        }
+        if (start > length)
+            start = length;
+        if (start == 0 && !atEnd) { // One row fills the whole buffer, so make it bigger
+            capacity *= 2;
+            buffer = realloc(buffer, capacity + 1);
+            ends = realloc(ends, (capacity + 1) * sizeof(int));
+        }
+        memmove(buffer, buffer + start, length - start);
+        length -= start;
+        consumed += start;
+        if (atEnd && requireNewline) // Anything left is a row that is not finished, so the offset stays before it
+            length = 0;
     }
+    if (errors > CSV_MAX_ERRORS)
+        printf("%s: %d more rows could not be read\n", fileName, errors - CSV_MAX_ERRORS);
+
+    *offset = consumed;
+    free(buffer);
+    free(ends);
+    fclose(csv);
+    return i;
 }
 
-void printNode(sightingNode *node) {
-    printf("%d/%d/%d at %02d:%02d in %s (%s, %s): %s for %d seconds; \"%s...\"",
-           node->dateTime.date.month,
-           node->dateTime.date.day,
-           node->dateTime.date.year,
-           node->dateTime.hour,
-           node->dateTime.minute,
-           node->city,
-           node->state,
-           node->country,
-           node->shape,
-           node->duration,
-           node->comment
-    );
+int readLastRow(char fileName[], long offset, sightingNode *node) {
+    FILE *csv = fopen(fileName, "r");
+    int result;
+
+    if (csv == NULL)
+        return 0;
+    fseek(csv, offset, SEEK_SET);
+    result = readNode(csv, node, 0, NULL);
+    fclose(csv);
+    if (result < 0)
+        printf("The last row of %s could not be read\n", fileName);
+    return result == 1;
 }
 
-void readStringToSpacer(FILE *csv, char string[]) {
-    char c = ' ';
-    int i = 0;
-    while (c != ',') { // Keep reading character by character until the comma
-        fscanf(csv, "%c", &c);
-        if (c == ',')
-            string[i] = '\0';
-        else
-            string[i] = c;
-        i++;
+int normalizeCity(char city[], char output[]) {
+    int length = 0;
+    int depth = 0; // How many parentheses deep the current character is
+    char *c;
+
+    output[length++] = ' '; // Start with a space so the first letters get trigrams of their own
+    for (c = city; *c != '\0' && length < MAX_CITY - 2; c++) {
+        if (*c == '(')
+            depth++;
+        else if (*c == ')' && depth > 0)
+            depth--;
+        else if (depth > 0)
+            continue;
+        else if ((*c >= 'a' && *c <= 'z') || (*c >= '0' && *c <= '9'))
+            output[length++] = *c;
+        else if (*c >= 'A' && *c <= 'Z')
+            output[length++] = (char) (*c - 'A' + 'a');
+        else if (output[length - 1] != ' ') // Anything else separates words
+            output[length++] = ' ';
     }
+    if (output[length - 1] != ' ')
+        output[length++] = ' ';
+    output[length] = '\0';
+    return length;
 }
 
-void searchByDate(sightingNode **results, sightingNode *head, datePredicate predicate, date d) {
-    sightingNode *node = head;
-    int i = 0;
-    int j;
-    while (i < MAX_SEARCH_RESULTS && node != NULL) { // Until we fill up the array
-        if (predicate(node, d)) { // Use the input function to check the current node
-            results[i] = node;
-            i++; // If it matches, up the count
+int nodeEquals(sightingNode *n1, sightingNode *n2) {
+    double latitude = n1->latitude - n2->latitude;
+    double longitude = n1->longitude - n2->longitude;
+    // Coordinates match if they round to the same 7 decimals that saveNode writes, and server answers print
+    return dateTimeCompare(n1, n2, 1) == 0 &&
+           dateReportedCompare(n1, n2, 1) == 0 &&
+           n1->duration == n2->duration &&
+           strcmp(n1->city, n2->city) == 0 &&
+           strcmp(n1->state, n2->state) == 0 &&
+           strcmp(n1->country, n2->country) == 0 &&
+           strcmp(n1->shape, n2->shape) == 0 &&
+           strcmp(n1->comment, n2->comment) == 0 &&
+           latitude < 0.00000006 && latitude > -0.00000006 &&
+           longitude < 0.00000006 && longitude > -0.00000006;
+}
+
+int parseNode(char line[], sightingNode *node) {
+    char error[MAX_LINE];
+    return parseRecord(line, node, error);
+}
+
+int parseRecord(char line[], sightingNode *node, char error[]) {
+    int length = (int) strlen(line);
+    int *ends = malloc((length + 2) * sizeof(int)); // No more than one end for each byte
+    int count = scanStructure(line, length, ends, length + 1);
+    int parsed;
+
+    ends[count++] = length; // The end of the string also ends the row
+    parsed = convertRow(line, 0, ends, count, node, error) > 0 && error[0] == '\0';
+    free(ends);
+    return parsed;
+}
+
+int readNode(FILE *csv, sightingNode *node, int requireNewline, csvPosition *position) {
+    char error[MAX_LINE];
+    char *line = NULL;
+    long start;
+    char *end, *c;
+    int capacity = 0;
+    int len;
+    int open;
+    int result;
+
+    do {
+        start = ftell(csv);
+        if ((len = readRecord(csv, &line, &capacity, &open)) == 0) {
+            free(line);
+            return 0;
+        }
+        // A row only stops short of its newline at the end of the file
+        if (requireNewline && (line[len - 1] != '\n' || open)) { // It is still being written, so leave it for next time
+            clearerr(csv);
+            fseek(csv, start, SEEK_SET);
+            free(line);
+            return 0;
         }
-        node = node->next; // Move onto the next node
+        if (position != NULL && (line[0] == '\n' || line[0] == '\r'))
+            position->line++;
+    } while (line[0] == '\n' || line[0] == '\r'); // Blank lines are not rows
+
+    result = parseRecord(line, node, error) ? 1 : -1;
+    end = strchr(line, '\n');
+    if (result < 0 && position != NULL && position->errors++ < CSV_MAX_ERRORS)
+        printf("%s line %ld: %s\n", position->name, position->line, error);
+    // A stray quote may have taken in the lines after it, so skip only this line
+    if (result < 0 && end != NULL && end[1] != '\0') {
+        fseek(csv, start + (end - line) + 1, SEEK_SET);
+        end[1] = '\0';
     }
-    for (j = i; j < MAX_SEARCH_RESULTS; j++)
-        results[j] = NULL; // Fill the rest of the array with NULL for consistency
+    for (c = line; position != NULL && *c != '\0'; c++) // Every line the row took up
+        position->line += *c == '\n';
+    free(line);
+    return result;
 }
 
-void searchByString(sightingNode **results, sightingNode *head, stringPredicate predicate, char string[]) {
-    sightingNode *node = head;
-    int i = 0;
-    int j;
-    while (i < MAX_SEARCH_RESULTS && node != NULL) {
-        if (predicate(node, string)) { // Same code as searchByDate except predicate takes in a string
-            results[i] = node;
-            i++;
-        }
-        node = node->next;
+int trigram(char s[]) {
+    int i, code, t = 0;
+    for (i = 0; i < 3; i++) {
+        if (s[i] >= 'a' && s[i] <= 'z')
+            code = s[i] - 'a' + 1;
+        else if (s[i] >= '0' && s[i] <= '9')
+            code = s[i] - '0' + 27;
+        else
+            code = 0;
+        t = t * TRIGRAM_CHARS + code;
     }
-    for (j = i; j < MAX_SEARCH_RESULTS; j++)
-        results[j] = NULL;
+    return t;
 }
 
-void sortBy(sightingNode **head, int size, int dir, compare function) {
-    // Carry out bubble sort
-    sightingNode **cur, *ptr1, *ptr2;
-    int sorted, i, j;
-    for (i = 0; i < size; i++) {
-        cur = head;
-        sorted = 1;
-        for (j = 0; j < size - i - 1; j++) {
-            ptr1 = *cur;
-            ptr2 = ptr1->next;
-            if (function(ptr1, ptr2, dir) > 0) { // Use given function to check ordering
-                *cur = swapNodes(ptr1, ptr2); // Swap nodes if needed
-                sorted = 0;
+int replayJournal(char journalName[], sightingNode **head) {
+    FILE *journal = fopen(journalName, "r");
+    char *line = NULL;
+    sightingNode *node;
+    sightingNode **cur;
+    int capacity = 0;
+    int change = 0;
+    int entries = 0;
+    int open;
+
+    if (journal == NULL) // No journal means no changes since the last compaction
+        return 0;
+    while (readRecord(journal, &line, &capacity, &open) > 0) {
+        node = malloc(sizeof(sightingNode));
+        if (!parseNode(line + 1, node)) { // A partly written last entry from a crash is ignored
+            free(node);
+            continue;
+        }
+        entries++;
+        if (line[0] == '+') { // Additions go at the top, the same as addEntry
+            node->next = *head;
+            *head = node;
+            change++;
+        } else if (line[0] == '-') { // Removals take out the first matching node
+            for (cur = head; *cur != NULL && !nodeEquals(*cur, node); cur = &(*cur)->next);
+            if (*cur != NULL) {
+                free(node);
+                node = *cur;
+                *cur = node->next;
+                change--;
             }
-            cur = &(*cur)->next; // Set the current double pointer to the address of the next node of the new current
+            free(node);
+        } else {
+            free(node);
         }
-        if (sorted) // This indicates no swaps were made, so the list is sorted
-            break;
     }
-}
 
-void saveNode(FILE *file, sightingNode *node) {
-    fprintf(file, "%d/%d/%d %02d:%02d,%s,%s,%s,%s,%d,%s,%d/%d/%d,%lf,%lf",
-            node->dateTime.date.month,
-            node->dateTime.date.day,
-            node->dateTime.date.year,
-            node->dateTime.hour,
-            node->dateTime.minute,
-            node->city,
-            node->state,
-            node->country,
-            node->shape,
-            node->duration,
-            node->comment,
-            node->dateReported.month,
-            node->dateReported.day,
-            node->dateReported.year,
-            node->longitude,
-            node->latitude
-    );
+    free(line);
+    fclose(journal);
+    if (entries > 0)
+        printf("Replayed %d changes from %s\n", entries, journalName);
+    return change;
 }
 
-int contains(char c, char arr[], int len) {
+int runBatch(int argc, char *argv[]) {
+    sightingNode *head;
+    FILE *file;
+    compare function;
+    columnStore store;
+    char *wanted;
+    long offset;
+    long written;
+    int size;
+    int dir;
+    int skipped;
+    int threads;
+    int queries;
+    int numClusters;
+    int km;
+    int days;
+    int minimum;
+    int *labels;
+    clusterSummary *summaries;
+    viewIndex view = {NULL, 0, 0};
+    double start;
     int i;
-    for (i = 0; i < len; i++)
-        if (arr[i] == c)
+
+    if (argc == 4 && strcmp(argv[1], "--dedup") == 0) {
+        file = fopen(argv[2], "r");
+        if (file == NULL) {
+            printf("There is no file called %s\n", argv[2]);
             return 1;
-    return 0;
-}
+        }
+        fclose(file);
+        head = malloc(sizeof(sightingNode));
+        size = loadData(argv[2], head, &offset, 0);
+        if (size > 0)
+            size -= dedupData(&head, 1, NULL);
+        file = fopen(argv[3], "w");
+        if (file == NULL) {
+            printf("Could not write to %s\n", argv[3]);
+            freeData(head);
+            return 1;
+        }
+        if (size > 0) {
+            saveList(file, head);
+            freeData(head);
+        } else {
+            free(head);
+        }
+        fclose(file);
+        printf("Saved %d sightings without duplicates to %s\n", size, argv[3]);
+        return 0;
+    }
 
-int containsNull(sightingNode *arr[MAX_SEARCH_RESULTS]) {
-    int i;
-    for (i = 0; i < MAX_SEARCH_RESULTS; i++)
-        if (arr[i] == NULL)
+    if (argc == 4 && strcmp(argv[1], "--compress") == 0) {
+        file = fopen(argv[2], "r");
+        if (file == NULL) {
+            printf("There is no file called %s\n", argv[2]);
             return 1;
-    return 0;
-}
+        }
+        fclose(file);
+        head = malloc(sizeof(sightingNode));
+        size = loadData(argv[2], head, &offset, 0);
+        if (size > 0) {
+            skipped = compressData(&store, head);
+            freeData(head);
+        } else {
+            skipped = compressData(&store, NULL);
+            free(head);
+        }
+        if (!saveColumns(argv[3], &store)) {
+            printf("Could not write to %s\n", argv[3]);
+            freeColumns(&store);
+            return 1;
+        }
+        if (skipped > 0)
+            printf("Left out %d sightings with dates that could not be encoded\n", skipped);
+        printf("Compressed %d sightings into %s: %ld bytes in memory as rows, %ld as columns (%.1fx smaller)\n",
+               store.size, argv[3], (long) store.size * (long) sizeof(sightingNode), columnBytes(&store),
+               (double) store.size * sizeof(sightingNode) / columnBytes(&store));
+        freeColumns(&store);
+        return 0;
+    }
 
-int loadData(char fileName[], sightingNode *head) {
-    FILE *csv = fopen(fileName, "r");
-    sightingNode *node = head;
-    int i = 0;
-    char junk;
+    if ((argc == 4 && strcmp(argv[1], "--decompress") == 0) || (argc == 5 && strcmp(argv[1], "--query") == 0)) {
+        if (!loadColumns(argv[2], &store)) {
+            printf("%s is not a compressed sightings file\n", argv[2]);
+            return 1;
+        }
+        if (argc == 5) { // Filter on the compressed columns and only decode the matches
+            wanted = malloc(store.size + 1);
+            size = searchColumns(&store, argv[3][0], argv[4], wanted);
+            written = size >= 0 ? writeColumns(&store, stdout, wanted) : 0;
+            if (size >= 0 && written >= 0)
+                printf("%d results\n", size);
+            free(wanted);
+            freeColumns(&store);
+            if (written < 0) {
+                printf("%s is damaged\n", argv[2]);
+                return 1;
+            }
+            if (size >= 0)
+                return 0;
+        } else {
+            file = fopen(argv[3], "w");
+            if (file == NULL) {
+                printf("Could not write to %s\n", argv[3]);
+                freeColumns(&store);
+                return 1;
+            }
+            written = writeColumns(&store, file, NULL);
+            fclose(file);
+            freeColumns(&store);
+            if (written < 0) {
+                printf("%s is damaged\n", argv[2]);
+                return 1;
+            }
+            printf("Saved %ld sightings to %s\n", written, argv[3]);
+            return 0;
+        }
+    }
 
-    while (1) { // Continue reading lines until the loop breaks
-        i++;
-        // Various methods of reading in data
-        fscanf(csv, "%d/%d/%4d %2d:%2d,",
-               &node->dateTime.date.month,
-               &node->dateTime.date.day,
-               &node->dateTime.date.year,
-               &node->dateTime.hour,
-               &node->dateTime.minute
-        );
-        readStringToSpacer(csv, node->city);
-        readStringToSpacer(csv, node->state);
-        readStringToSpacer(csv, node->country);
-        readStringToSpacer(csv, node->shape);
-        fscanf(csv, "%d,", &node->duration);
-        readStringToSpacer(csv, node->comment);
-        fscanf(csv, "%d/%d/%4d,%lf,%lf\n",
-               &node->dateReported.month,
-               &node->dateReported.day,
-               &node->dateReported.year,
-               &node->longitude,
-               &node->latitude
-        );
-        // Check if we are at the end
-        if (fscanf(csv, "%c", &junk) == EOF) break;
-        fseek(csv, -1, SEEK_CUR); // If not, move back so we don't lose anything
-        node->next = malloc(sizeof(sightingNode)); // Allocate memory for the next node that was just read
-        node = node->next; // Move on
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--serve") == 0)
+        return !serveData(argv[2], argc > 3 ? argv[3] : SERVER_SOCKET);
+
+    if (argc <= 3 && strcmp(argv[1], "--client") == 0)
+        return !runClient(argc > 2 ? argv[2] : SERVER_SOCKET);
+
+    if (argc <= 5 && strcmp(argv[1], "--bench") == 0) {
+        threads = argc > 3 ? atoi(argv[3]) : BENCH_CONNECTIONS;
+        queries = argc > 4 ? atoi(argv[4]) : BENCH_QUERIES;
+        if (threads > 0 && queries > 0)
+            return !benchServer(argc > 2 ? argv[2] : SERVER_SOCKET, threads, queries);
     }
 
-    fclose(csv);
-    return i;
+    if (argc >= 3 && argc <= 6 && strcmp(argv[1], "--clusters") == 0) {
+        km = argc > 3 ? atoi(argv[3]) : CLUSTER_DISTANCE_KM;
+        days = argc > 4 ? atoi(argv[4]) : CLUSTER_DAYS;
+        minimum = argc > 5 ? atoi(argv[5]) : CLUSTER_MIN_SIGHTINGS;
+        if (km < 1 || days < 1 || minimum < 1) {
+            printf("Usage: %s --clusters input.csv [km] [days] [min sightings], each number at least 1\n", argv[0]);
+            return 1;
+        }
+        file = fopen(argv[2], "r");
+        if (file == NULL) {
+            printf("There is no file called %s\n", argv[2]);
+            return 1;
+        }
+        fclose(file);
+        head = malloc(sizeof(sightingNode));
+        size = loadData(argv[2], head, &offset, 0);
+        if (size == 0) {
+            free(head);
+            head = NULL;
+        }
+        buildView(&view, head);
+        labels = malloc((size + 1) * sizeof(int));
+        start = secondsNow();
+        numClusters = findClusters(&view, km, days, minimum, labels);
+        printf("Found %d clusters among %d sightings in %.2f seconds\n", numClusters, size, secondsNow() - start);
+        summaries = malloc((numClusters + 1) * sizeof(clusterSummary));
+        summarizeClusters(&view, labels, numClusters, summaries);
+        for (i = 0; i < numClusters; i++)
+            printCluster(i + 1, &summaries[i]);
+        free(summaries);
+        free(labels);
+        freeView(&view);
+        if (head != NULL)
+            freeData(head);
+        return 0;
+    }
+
+    if (argc == 4 && strcmp(argv[1], "--arrow") == 0) {
+        file = fopen(argv[2], "r");
+        if (file == NULL) {
+            printf("There is no file called %s\n", argv[2]);
+            return 1;
+        }
+        fclose(file);
+        head = malloc(sizeof(sightingNode));
+        size = loadData(argv[2], head, &offset, 0);
+        if (size == 0) {
+            free(head);
+            head = NULL;
+        }
+        buildView(&view, head);
+        i = exportArrow(argv[3], &view);
+        if (i)
+            printf("Exported %d sightings to %s\n", view.size, argv[3]);
+        else
+            printf("Could not write to %s\n", argv[3]);
+        freeView(&view);
+        if (head != NULL)
+            freeData(head);
+        return i ? 0 : 1;
+    }
+
+    if (argc >= 4 && argc <= 6 && strcmp(argv[1], "--external-sort") == 0) {
+        function = parseSortField(argc > 4 ? argv[4] : "d", &dir);
+        if (function != NULL)
+            return externalSort(argv[2], argv[3], dir, function,
+                                (argc > 5 ? atol(argv[5]) : EXTERNAL_SORT_DEFAULT_MB) * 1024 * 1024) ? 0 : 1;
+    }
+
+    if (argc >= 5 && strcmp(argv[1], "--merge") == 0) {
+        function = parseSortField(argv[3], &dir);
+        if (function != NULL)
+            return mergeFiles(argv + 4, argc - 4, argv[2], dir, function, &skipped) >= 0 && skipped == 0 ? 0 : 1;
+    }
+
+    printf("Usage: %s [--dedup input.csv output.csv]\n"
+           "       %s [--external-sort input.csv output.csv [field d|t|s|c|h|u|p, capital to reverse] [memory MB]]\n"
+           "       %s [--merge output.csv field sorted1.csv sorted2.csv ...]\n"
+           "       %s [--compress input.csv output.ufoc]\n"
+           "       %s [--decompress input.ufoc output.csv]\n"
+           "       %s [--query input.ufoc field d|t|s|c|h|p value]\n"
+           "       %s [--serve input.csv [socket]]\n"
+           "       %s [--client [socket]]\n"
+           "       %s [--bench [socket] [connections] [queries per connection]]\n"
+           "       %s [--clusters input.csv [km] [days] [min sightings]]\n"
+           "       %s [--arrow input.csv output.arrow]\n",
+           argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 1;
 }
 
-int removeEntry(sightingNode **node) {
+int removeEntry(sightingNode **head, viewIndex *view, int location, FILE *journal) {
     char out[] = " \0\0";
-    int index, i;
-    sightingNode **rNode = node;
+    int index;
+    sightingNode **rNode = head;
     sightingNode *temp;
 
-    if (*node == NULL) {
+    if (location >= view->size) {
         printf("No displayed nodes to remove. Returning...\n");
         return 0;
     }
@@ -794,28 +5558,27 @@ int removeEntry(sightingNode **node) {
     } while (sscanf(out, "%d", &index) != 1 && out[0] != '\n');
     if (out[0] == '\n') index = 0;
 
-    // Find the node the user chose so it can be removed
-    for (i = 0; i < index; i++) {
-        if ((*rNode)->next != NULL || i == 10) {
-            rNode = &(*rNode)->next;
-        } else { // Or determine that it is not able to be removed
-            printf("That node does not exist. Returning...\n");
-            return 0;
-        }
+    // The view finds the node the user chose directly, or determines that it is not able to be removed
+    if (index < 0 || index >= MAX_SEARCH_RESULTS || location + index >= view->size) {
+        printf("That node does not exist. Returning...\n");
+        return 0;
     }
+    temp = view->rows[location + index];
 
-    // Do the pointer swap to remove the chosen node
-    temp = *rNode;
-    if (temp->next == NULL)
-        *rNode = NULL;
-    else
-        *rNode = (*rNode)->next;
+    // Find the pointer to the node in the list and do the pointer swap to remove it
+    while (*rNode != temp)
+        rNode = &(*rNode)->next;
+    *rNode = temp->next;
+    memmove(view->rows + location + index, view->rows + location + index + 1,
+            (view->size - location - index - 1) * sizeof(sightingNode *));
+    view->size--;
+    journalEntry(journal, '-', temp);
     free(temp);
     printf("Removed node %d\n", index);
     return 1;
 }
 
-int saveData(sightingNode *head) {
+int saveData(sightingNode *head, char dataName[], FILE **journal, long *offset) {
     FILE *file;
     char fileName[41]; // String to store the user-entered file name
     char createNewFile; // To get input from the user later
@@ -834,8 +5597,14 @@ int saveData(sightingNode *head) {
         }
     } else { // Otherwise, make sure to close the file before the next step
         fclose(file);
+        if (sameFile(fileName, dataName)) // The journal must not be replayed onto rows that already have its changes
+            return compactData(dataName, head, journal, offset);
     }
     file = fopen(fileName, "w"); // NOW open it in write mode. If it did not exist before, it will be created
+    if (file == NULL) {
+        printf("Could not write to %s. Save cancelled\n", fileName);
+        return 0;
+    }
 
     // Save each node as long as they exist, and move to the next each time
     while (node != NULL) {
@@ -850,6 +5619,13 @@ int saveData(sightingNode *head) {
     return 1;
 }
 
+int sameFile(char name1[], char name2[]) {
+    struct stat s1, s2;
+    if (stat(name1, &s1) != 0 || stat(name2, &s2) != 0)
+        return 0;
+    return s1.st_dev == s2.st_dev && s1.st_ino == s2.st_ino;
+}
+
 // Comparison and predicate functions
 int dateTimeCompare(sightingNode *n1, sightingNode *n2, int dir) {
     // -1 == d1 before
@@ -914,6 +5690,8 @@ int shapeCompare(sightingNode *n1, sightingNode *n2, int dir) {
 }
 
 int durationCompare(sightingNode *n1, sightingNode *n2, int dir) {
+    if (n1->duration == n2->duration)
+        return 0;
     return n1->duration > n2->duration ? dir : -dir;
 }
 
@@ -969,11 +5747,38 @@ char menu(char message[], char optionsText[][MAX_MENU_OPTION], char options[], i
     return out[0];
 }
 
-sightingNode *swapNodes(sightingNode *ptr1, sightingNode *ptr2) {
-    sightingNode *tmp = ptr2->next;
-    ptr2->next = ptr1;
-    ptr1->next = tmp;
-    return ptr2;
+compare sortFunction(char option, compare prevSort, int *dir) {
+    switch (option) { // Set the proper comparison function depending on user input
+        case 'd':
+            return dateTimeCompare;
+        case 't':
+            return cityCompare;
+        case 's':
+            return stateCompare;
+        case 'c':
+            return countryCompare;
+        case 'h':
+            return shapeCompare;
+        case 'u':
+            return durationCompare;
+        case 'p':
+            return dateReportedCompare;
+        default: // r = reverse
+            *dir *= -1;
+            return prevSort;
+    }
+}
+
+compare parseSortField(char field[], int *dir) {
+    char option = field[0];
+    *dir = 1;
+    if (option >= 'A' && option <= 'Z') {
+        option = (char) (option - 'A' + 'a');
+        *dir = -1;
+    }
+    if (field[0] == '\0' || field[1] != '\0' || !contains(option, "dtschup", 7))
+        return NULL;
+    return sortFunction(option, NULL, dir);
 }
 
 /**
@@ -981,4 +5786,4 @@ sightingNode *swapNodes(sightingNode *ptr1, sightingNode *ptr2) {
 * Data: https://www.kaggle.com/datasets/NUFORC/ufo-sightings/data?select=scrubbed.csv
 * Linked list bubble sort: https://www.prepbytes.com/blog/linked-list/c-program-for-performing-bubble-sort-on-linked-list/
 * Higher order functions: https://medium.com/nerd-for-tech/higher-order-functions-in-c-74f6c4b550ee
-*/
\ No newline at end of file
+*/